@@ -0,0 +1,238 @@
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+
+#include <iomanip>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "external_sort.h"
+#include "file_mapper.h"
+#include "generator.h"
+#include "record.h"
+#include "util.h"
+
+const char *kInput = "benchmark.in";
+const char *kOutput = "benchmark.out";
+const char *kTemp = "benchmark.temp";
+const char *kSpare = "benchmark.temp.spare";
+
+// Parameters shared by all benchmarked inputs
+struct Arguments {
+  // Sizes in bytes
+  size_t size;
+  size_t memory;
+  bool mapped;
+  bool direct;
+};
+
+// Check that file holds count elements ordered by compare
+template <typename T, typename Compare>
+bool IsSorted(const std::string &name, size_t count, Compare compare) {
+  const size_t kBuffer = 1 << 16;
+
+  FileMapper<T> file(name);
+  if (file.Count() != count)
+    return false;
+
+  std::vector<T> buffer(kBuffer + 1);
+  size_t read = 0;
+  size_t fetched;
+  while ((fetched = file.Read(&buffer[1], kBuffer, read))) {
+    const size_t first = read ? 0 : 1;
+    for (size_t i = first + 1; i <= fetched; ++i) {
+      if (compare(buffer[i], buffer[i - 1]))
+        return false;
+    }
+    buffer[0] = buffer[fetched];
+    read += fetched;
+  }
+
+  return true;
+}
+
+// Sort input of given distribution and print one row of results;
+// returns false if output turns out to be wrong
+template <typename T, typename Compare>
+bool Run(Distribution distribution, const Arguments &arguments, SortOptions options) {
+  const double kMebi = 1 << 20;
+  auto mode = FileMapper<T>::Mode::kStream;
+  if (arguments.mapped)
+    mode = FileMapper<T>::Mode::kMapped;
+  else if (arguments.direct)
+    mode = FileMapper<T>::Mode::kDirect;
+
+  const size_t count = arguments.size / sizeof(T);
+  {
+    std::ofstream input(kInput, std::ios::binary | std::ios::trunc);
+    Generate<T>(distribution, count, 0, &input);
+  }
+
+  SortStats stats;
+  size_t temp_read, temp_written;
+  {
+    FileMapper<T> file(kInput, mode);
+    FileMapper<T> temp(kTemp, std::ios::trunc, mode);
+    FileMapper<T> spare(kSpare, std::ios::trunc, mode);
+    FileMapper<T> destination(kOutput, std::ios::trunc,
+                              arguments.direct ? FileMapper<T>::Mode::kDirect : FileMapper<T>::Mode::kStream);
+
+    options.memory = std::max<size_t>(arguments.memory / sizeof(T), 1);
+    stats = external_sort(&file, &temp, &spare, &destination, options, Compare());
+
+    // Mapped temp is partly accessed through views, which are not counted
+    temp_read = temp.BytesRead() + spare.BytesRead();
+    temp_written = temp.BytesWritten() + spare.BytesWritten();
+  }
+
+  const bool sorted = IsSorted<T>(kOutput, count, Compare());
+
+  rusage usage;
+  ::getrusage(RUSAGE_SELF, &usage);
+
+  const double total_time = stats.run_generation_time + stats.merge_time;
+  std::cout << std::fixed << std::setprecision(3)
+            << std::setw(12) << DistributionName(distribution)
+            << std::setw(7) << stats.runs
+            << std::setw(7) << stats.passes
+            << std::setw(10) << stats.run_generation_time
+            << std::setw(10) << stats.merge_time
+            << std::setw(10) << std::setprecision(1)
+            << (total_time > 0 ? count * sizeof(T) / kMebi / total_time : 0.0)
+            << std::setw(10) << temp_read / kMebi
+            << std::setw(10) << temp_written / kMebi
+            << std::setw(10) << usage.ru_maxrss / 1024.0
+            << std::setw(8) << (sorted ? "ok" : "FAILED") << std::endl;
+
+  return sorted;
+}
+
+// Every input is sorted in separate process, so that peak memory
+// of one run does not hide the others
+template <typename T, typename Compare = std::less<T>>
+bool Benchmark(const Arguments &arguments, const SortOptions &options) {
+  std::cout << std::setw(12) << "input"
+            << std::setw(7) << "runs"
+            << std::setw(7) << "passes"
+            << std::setw(10) << "runs, s"
+            << std::setw(10) << "merge, s"
+            << std::setw(10) << "MB/s"
+            << std::setw(10) << "read, MB"
+            << std::setw(10) << "write, MB"
+            << std::setw(10) << "RSS, MB"
+            << std::setw(8) << "result" << std::endl;
+
+  bool success = true;
+  for (int i = 0; i < static_cast<int>(Distribution::kDistributionNum); ++i) {
+    const pid_t child = ::fork();
+    if (child == 0) {
+      const bool sorted = Run<T, Compare>(static_cast<Distribution>(i), arguments, options);
+      std::exit(sorted ? 0 : 1);
+    }
+
+    int status;
+    ::waitpid(child, &status, 0);
+    success = success && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+
+  std::remove(kInput);
+  std::remove(kOutput);
+  std::remove(kTemp);
+  std::remove(kSpare);
+
+  return success;
+}
+
+int main(int argc, char **argv) {
+  bool mapped = false;
+  bool direct = false;
+  std::string type = "char";
+  SortOptions options;
+  options.workers = std::max(std::thread::hardware_concurrency(), 1u);
+  options.replacement_selection = false;
+  options.compressed = false;
+  options.io_threads = 2;
+  options.device = DeviceProfile{0.0001, 500.0 * (1 << 20)};
+  options.limit = 0;
+
+  int option;
+  while ((option = ::getopt(argc, argv, "e:mdj:rzp:")) != -1) {
+    switch (option) {
+      case 'e':
+        type = optarg;
+        break;
+
+      case 'm':
+        mapped = true;
+        break;
+
+      case 'd':
+        direct = true;
+        break;
+
+      case 'j':
+        options.workers = std::max(std::stoi(optarg), 1);
+        break;
+
+      case 'r':
+        options.replacement_selection = true;
+        break;
+
+      case 'z':
+        options.compressed = true;
+        break;
+
+      case 'p':
+        options.io_threads = std::max(std::stoi(optarg), 0);
+        break;
+
+      default:
+        return 1;
+    }
+  }
+
+  if (argc - optind < 2) {
+    std::cout << "Usage: " << argv[0] << " [-e TYPE] [-m | -d] [-j WORKERS] [-r] [-z] [-p THREADS] SIZE MEMORY" << std::endl
+              << "  Sort SIZE bytes of uniform, sorted, reverse, few-unique and Zipf inputs" << std::endl
+              << "  with MEMORY limit; options are the same as of sort" << std::endl;
+
+    return 0;
+  }
+
+  if (options.compressed && type == "record") {
+    std::cout << "Compression is not supported for " << type << std::endl;
+    return 1;
+  }
+
+  Arguments arguments;
+  arguments.size = ParseSize(argv[optind]);
+  arguments.memory = ParseSize(argv[optind + 1]);
+  arguments.mapped = mapped;
+  arguments.direct = direct;
+
+  bool success;
+  if (type == "char") {
+    success = Benchmark<char>(arguments, options);
+  } else if (type == "int32") {
+    success = Benchmark<int32_t>(arguments, options);
+  } else if (type == "int64") {
+    success = Benchmark<int64_t>(arguments, options);
+  } else if (type == "uint64") {
+    success = Benchmark<uint64_t>(arguments, options);
+  } else if (type == "double") {
+    success = Benchmark<double>(arguments, options);
+  } else if (type == "record") {
+    success = Benchmark<KeyedRecord, KeyedRecordLess>(arguments, options);
+  } else {
+    std::cout << "Unknown type " << type << std::endl;
+    return 1;
+  }
+
+  return success ? 0 : 1;
+}
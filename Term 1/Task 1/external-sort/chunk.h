@@ -4,58 +4,128 @@
 #include <cstring>
 
 #include <algorithm>
+#include <future>
 
 #include "file_mapper.h"
+#include "record.h"
+#include "reducer.h"
+#include "run_format.h"
+#include "thread_pool.h"
+#include "top_k.h"
+
+// Turn size elements read from input into sorted run folded with reducer
+// and cut by cutoff unless it is null; returns number of elements in run
+template <typename T, typename Compare, typename Reducer>
+size_t PrepareRun(T *data, size_t size, Compare compare, Reducer reducer,
+                  RunCutoff<T, Compare> *cutoff) {
+  InitElements(data, data + size, reducer);
+  if (cutoff)
+    size = cutoff->Filter(data, data + size) - data;
+
+  SortElements(data, data + size, compare);
+  size = Reduce(data, data + size, compare, reducer) - data;
+
+  if (cutoff) {
+    size = std::min(size, cutoff->Limit());
+    cutoff->AddRun(data, size);
+  }
+
+  return size;
+}
+
+// Sort size elements of file starting from offset and put them into temp
+// as a run starting from byte temp_offset, folding equal elements with
+// reducer and leaving only those which may get into result by cutoff
+// unless it is null; returns number of elements in run
+template <typename T, typename Compare, typename Reducer>
+size_t SortRun(FileMapper<T> *file, FileMapper<T> *temp, size_t size, size_t offset,
+               size_t temp_offset, bool compressed, Compare compare, Reducer reducer,
+               RunCutoff<T, Compare> *cutoff) {
+  if (temp->Mapped() && !compressed) {
+    // Sort right inside of temp
+    Span<T> run = temp->View(size, temp_offset / sizeof(T));
+    size = file->Read(run.data, run.size, offset);
+    return PrepareRun(run.data, size, compare, reducer, cutoff);
+  }
+
+  T *data = new T[size];
+  size = file->Read(data, size, offset);
+  size = PrepareRun(data, size, compare, reducer, cutoff);
+
+  RunWriter<T> writer(temp, temp_offset, compressed);
+  writer.Write(data, size);
+  writer.Close();
+  delete[] data;
 
-// Used for fetching elements of FileMapper
-// in increasing order
+  return size;
+}
+
+// Used for fetching sorted elements of FileMapper
+// in order they were sorted
 // Elements are bufferized to reduce amount of IO operations
+// and may be double-buffered with loading done in background
 template <typename T>
 class SortingChunk {
  public:
-  SortingChunk(FileMapper<T> *file, FileMapper<T> *temp, size_t size, size_t offset, size_t buffer_size)
-    : file_(temp),
-      begin_(offset),
+  // Chunk of run of size sorted elements starting from byte offset of file
+  SortingChunk(FileMapper<T> *file, size_t size, size_t offset, size_t buffer_size,
+               bool compressed)
+    : reader_(file, offset, size, compressed, buffer_size),
       size_(size),
-      position_(begin_),
-      buffer_size_(buffer_size) {
-    T *data = new T[size_];
-    size_ = file->Read(data, size_, begin_);
-    end_ = begin_ + size_;
-
-    std::sort(data, data + size_);
-    
-    file_->Write(data, size_, begin_);
-    delete[] data;
+      position_(0),
+      load_position_(0),
+      buffer_size_(buffer_size),
+      buffer_(nullptr),
+      back_buffer_(nullptr),
+      io_(nullptr) {
+    if (file->Mapped() && !compressed) {
+      // Read merged elements from mapped file directly; mapping covers
+      // whole file, so elements missing from view are not there at all,
+      // and chunk is cut rather than reading them into absent buffer
+      Span<T> run = file->View(size_, offset / sizeof(T));
+      size_ = run.size;
+      load_position_ = size_;
+
+      buffer_position_ = run.data;
+      buffer_end_ = run.data + run.size;
+      return;
+    }
 
     buffer_position_ = buffer_ = new T[buffer_size_];
     LoadBuffer();
   }
 
-  SortingChunk(const SortingChunk &source)
-    : file_(source.file_),
-      begin_(source.begin_),
-      size_(source.size_),
-     position_(source.position_),
-     end_(source.end_),
-     buffer_size_(source.buffer_size_) {
-    buffer_ = new T[buffer_size_];
-    buffer_position_ = buffer_ + (source.buffer_position_- source.buffer_);
-    buffer_end_ = buffer_ + (source.buffer_end_ - source.buffer_);
-
-    ::memcpy(buffer_, source.buffer_, buffer_size_ * sizeof(T));
-  }
+  SortingChunk(const SortingChunk &) = delete;
+  SortingChunk & operator=(const SortingChunk &) = delete;
 
   ~SortingChunk() {
+    if (prefetch_.valid())
+      prefetch_.wait();
+
     delete []buffer_;
+    delete []back_buffer_;
+  }
+
+  // Refill buffers in background using io threads;
+  // next portion is loaded while current one is being consumed
+  void EnablePrefetch(thread_pool<void> *io) {
+    if (!buffer_)
+      return;
+
+    io_ = io;
+    back_buffer_ = new T[buffer_size_];
+    Prefetch();
   }
 
   // Get next element
   T Get() {
-    if(position_ >= end_)
+    if(position_ >= size_)
       throw 1;
     if (buffer_position_ == buffer_end_) {
-      LoadBuffer();
+      if (io_)
+        SwapBuffers();
+      else
+        LoadBuffer();
     }
     ++position_;
 
@@ -64,35 +134,85 @@ class SortingChunk {
     return element;
   }
 
+  // Get all buffered elements at once, loading next portion if necessary;
+  // returned elements stay valid until next call
+  Span<T> Fetch() {
+    if (position_ >= size_)
+      return Span<T>{nullptr, 0};
+    if (buffer_position_ == buffer_end_) {
+      if (io_)
+        SwapBuffers();
+      else
+        LoadBuffer();
+    }
+
+    Span<T> batch{buffer_position_, size_t(buffer_end_ - buffer_position_)};
+    position_ += batch.size;
+    buffer_position_ = buffer_end_;
+
+    return batch;
+  }
+
   // Get amount of available elements in FileMapper
   size_t ElementsLeft() {
-    return end_ - position_;
+    return size_ - position_;
   }
 
  private:
   // Load next part of the buffer int memory
   size_t LoadBuffer() {
-    size_t count = buffer_size_;
-    if (position_ + count >= end_)
-      count = ElementsLeft();
-
-    size_t fetched = file_->Read(buffer_, count, position_);
+    size_t fetched = Load(buffer_);
     buffer_position_ = buffer_;
     buffer_end_ = buffer_ + fetched;
 
     return fetched;
   }
 
-  FileMapper<T> *file_;
-  size_t begin_;
+  // Read elements following already loaded ones into buffer
+  size_t Load(T *buffer) {
+    size_t fetched = reader_.Read(buffer, buffer_size_);
+    load_position_ += fetched;
+
+    return fetched;
+  }
+
+  // Start loading of back buffer if there is anything left
+  void Prefetch() {
+    if (load_position_ == size_)
+      return;
+
+    prefetch_ = io_->submit([this]() { back_fetched_ = Load(back_buffer_); });
+  }
+
+  // Make prefetched buffer current one and start loading the other
+  void SwapBuffers() {
+    io_->wait(prefetch_);
+    prefetch_.get();
+
+    std::swap(buffer_, back_buffer_);
+    buffer_position_ = buffer_;
+    buffer_end_ = buffer_ + back_fetched_;
+
+    Prefetch();
+  }
+
+  RunReader<T> reader_;
   size_t size_;
+  // Number of elements given away and loaded into buffers
   size_t position_;
-  size_t end_;
+  size_t load_position_;
 
   size_t buffer_size_;
+  // Own buffer; null if elements are viewed in mapped file
   T *buffer_;
   T *buffer_end_;
   T *buffer_position_;
+
+  // Buffer being filled in background and amount of elements put there
+  T *back_buffer_;
+  size_t back_fetched_;
+  thread_pool<void> *io_;
+  std::future<void> prefetch_;
 };
 
 #endif // CHUNK_H_
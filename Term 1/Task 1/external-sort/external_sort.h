@@ -2,59 +2,629 @@
 #define SORT_H_
 
 #include <cassert>
+#include <cstdio>
 
 #include <vector>
 #include <algorithm>
+#include <chrono>
+#include <deque>
 #include <stdexcept>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <typeinfo>
 
 #include "file_mapper.h"
 #include "chunk.h"
+#include "loser_tree.h"
+#include "merge_plan.h"
+#include "reducer.h"
+#include "replacement_selection.h"
+#include "run_format.h"
+#include "stream.h"
+#include "thread_pool.h"
+#include "top_k.h"
 
-// Put sorted content of file into destination;
-// temp is used for sorted chunks storing.
+// Parameters of external sort
+struct SortOptions {
+  // Number of elements allowed to be held in memory at once
+  size_t memory;
+  // Number of threads generating sorted runs and merging uncompressed ones;
+  // memory is split between them
+  size_t workers;
+  // Generate runs with single-threaded replacement selection instead
+  bool replacement_selection;
+  // Keep runs in temporary files compressed
+  bool compressed;
+  // Number of threads refilling merge buffers in background;
+  // if zero, buffers are refilled synchronously and are twice as large
+  size_t io_threads;
+  // Storage characteristics used for choosing number of runs merged at once
+  DeviceProfile device;
+  // File for saving progress between merge passes; empty if not needed.
+  // If it already contains progress of sorting, sort is resumed from it
+  std::string state;
+  // Number of smallest elements put into destination; zero if all are.
+  // If twice as much fits into memory, temporary files are not used at all
+  size_t limit;
+};
+
+// Get byte offsets of runs of given lengths placed one after another
+// and offset of their end
 template <typename T>
-void external_sort(FileMapper<T> *file, FileMapper<T> *temp,
-                   std::ofstream *destination, size_t chunk_size) {
-  assert(chunk_size != 0);
+std::vector<size_t> run_offsets(const std::vector<size_t> &runs, bool compressed) {
+  std::vector<size_t> offsets(1, 0);
+  for (auto run : runs)
+    offsets.push_back(offsets.back() + RunExtent<T>(run, compressed));
+
+  return offsets;
+}
+
+// What happened during sort
+struct SortStats {
+  // Time spent in each phase in seconds; merge includes all passes
+  double run_generation_time;
+  double merge_time;
+  // Number of generated runs and merge passes, including the final one
+  size_t runs;
+  size_t passes;
+};
+
+// Shuts pool down on leaving scope, also by an exception, so that its
+// workers are joined before anything their tasks use is destroyed;
+// thread_pool itself does not join them
+template <typename T>
+class PoolShutdown {
+ public:
+  explicit PoolShutdown(thread_pool<T> *pool) : pool_(pool) {}
+
+  PoolShutdown(const PoolShutdown &) = delete;
+  PoolShutdown & operator=(const PoolShutdown &) = delete;
 
+  ~PoolShutdown() {
+    pool_->shutdown();
+  }
+
+ private:
+  thread_pool<T> *pool_;
+};
+
+// Number of elements every worker sorts in memory at once: its share
+// of memory less what sorting takes besides elements themselves
+template <typename T, typename Compare>
+size_t run_length(const SortOptions &options) {
+  const size_t share = options.memory / options.workers;
+  return std::max<size_t>(share * sizeof(T) / (sizeof(T) + SortOverhead<T, Compare>::value), 1);
+}
+
+// Sort runs of file into temp using several threads; returns lengths
+// of runs and puts their byte offsets into offsets
+template <typename T, typename Compare, typename Reducer>
+std::vector<size_t> generate_runs(FileMapper<T> *file, FileMapper<T> *temp,
+                                  const SortOptions &options, Compare compare, Reducer reducer,
+                                  std::vector<size_t> *offsets) {
+  const size_t run_size = run_length<T, Compare>(options);
   const size_t total_count = file->Count();
-  const size_t chunks_num = total_count / chunk_size + (total_count % chunk_size ? 1 : 0);
-  const size_t portion = chunk_size >= chunks_num
-                              ? chunk_size / chunks_num
-                              : 1;
+  const size_t runs_num = total_count / run_size + (total_count % run_size ? 1 : 0);
+  const size_t run_extent = RunExtent<T>(run_size, options.compressed);
+  const bool compressed = options.compressed;
+
+  // Mapped temp has to be of full size before runs take views of it
+  if (temp->Mapped())
+    temp->Resize((runs_num * run_extent + sizeof(T) - 1) / sizeof(T));
+
+  std::vector<size_t> runs(runs_num);
+  offsets->resize(runs_num);
+  for (size_t i = 0; i < runs_num; ++i)
+    (*offsets)[i] = i * run_extent;
+
+  // Runs of partial sort keep only elements which may get into result
+  std::unique_ptr<RunCutoff<T, Compare>> cutoff;
+  if (options.limit)
+    cutoff.reset(new RunCutoff<T, Compare>(options.limit, !Reducer::kEnabled, compare));
+  RunCutoff<T, Compare> *run_cutoff = cutoff.get();
+
+  // Calling thread works too while waiting for results
+  thread_pool<void> pool(options.workers - 1);
+  PoolShutdown<void> shutdown(&pool);
+  std::vector<std::future<void>> futures;
+
+  for (size_t i = 0; i < runs_num; ++i) {
+    auto generate = [&runs, file, temp, run_size, run_extent, compressed, compare, reducer,
+                     run_cutoff, i]() {
+      runs[i] = SortRun(file, temp, run_size, i * run_size, i * run_extent, compressed,
+                        compare, reducer, run_cutoff);
+    };
+    futures.push_back(pool.submit(generate));
+  }
+
+  for (auto &future : futures) {
+    pool.wait(future);
+    future.get();
+  }
+
+  return runs;
+}
+
+// Sort runs of elements read from input into temp while input is still
+// being read, so that memory is enough for workers buffers at once;
+// returns lengths of runs and puts their byte offsets into offsets
+template <typename T, typename Compare, typename Reducer>
+std::vector<size_t> stream_runs(StreamReader<T> *input, FileMapper<T> *temp,
+                                const SortOptions &options, Compare compare, Reducer reducer,
+                                std::vector<size_t> *offsets) {
+  // Mapped file would have to be remapped while runs are written into it
+  if (temp->Mapped())
+    throw std::invalid_argument("runs of stream can not be put into mapped file");
+
+  const size_t run_size = run_length<T, Compare>(options);
+  const size_t run_extent = RunExtent<T>(run_size, options.compressed);
+  const bool compressed = options.compressed;
+
+  std::unique_ptr<RunCutoff<T, Compare>> cutoff;
+  if (options.limit)
+    cutoff.reset(new RunCutoff<T, Compare>(options.limit, !Reducer::kEnabled, compare));
+  RunCutoff<T, Compare> *run_cutoff = cutoff.get();
+
+  // Deque keeps lengths in place while new runs are added
+  std::deque<size_t> runs;
+  offsets->clear();
+
+  // Calling thread reads input and sorts runs while waiting for workers
+  thread_pool<void> pool(options.workers - 1);
+  PoolShutdown<void> shutdown(&pool);
+  std::deque<std::future<void>> futures;
+
+  for (;;) {
+    if (futures.size() == options.workers) {
+      pool.wait(futures.front());
+      futures.front().get();
+      futures.pop_front();
+    }
+
+    T *data = new T[run_size];
+    const size_t size = input->Read(data, run_size);
+    if (!size) {
+      delete[] data;
+      break;
+    }
+
+    const size_t i = runs.size();
+    runs.push_back(size);
+    offsets->push_back(i * run_extent);
 
-  std::vector<SortingChunk<T>> chunks;
-  { 
-    for(size_t offset = 0; offset < total_count; offset += chunk_size)
-      chunks.push_back(SortingChunk<T>(file, temp, chunk_size, offset, portion));
+    size_t *run = &runs.back();
+    auto generate = [run, data, temp, run_extent, compressed, compare, reducer, run_cutoff, i]() {
+      *run = PrepareRun(data, *run, compare, reducer, run_cutoff);
+
+      RunWriter<T> writer(temp, i * run_extent, compressed);
+      writer.Write(data, *run);
+      writer.Close();
+      delete[] data;
+    };
+    futures.push_back(pool.submit(generate));
   }
 
-  using min = std::pair<T, size_t>;
+  for (auto &future : futures) {
+    pool.wait(future);
+    future.get();
+  }
 
-  std::vector<min> heap;
-  for (size_t i = 0; i < chunks.size(); ++i)
-    heap.push_back(min(chunks[i].Get(), i));
-  std::make_heap(heap.begin(), heap.end(), std::greater<min>());
+  return std::vector<size_t>(runs.begin(), runs.end());
+}
 
-  T *merged_chunk = new T[chunk_size];
+// Merge runs_num runs of temp placed at given byte offsets and pass first
+// limit merged elements folded by reducer to output in portions
+template <typename T, typename Compare, typename Reducer>
+void merge_runs(FileMapper<T> *temp, const size_t *offsets, const size_t *runs, size_t runs_num,
+                size_t portion, bool compressed, thread_pool<void> *io, Compare compare,
+                Reducer reducer, size_t limit,
+                const std::function<void(const T *, size_t)> &output) {
+  std::vector<std::unique_ptr<SortingChunk<T>>> chunks;
+  for (size_t i = 0; i < runs_num; ++i)
+    chunks.emplace_back(new SortingChunk<T>(temp, runs[i], offsets[i], portion, compressed));
 
-  while (heap.size() > 0) {
-    for(size_t count = 0; count < chunk_size && heap.size(); ++count) {
-      size_t chunk = heap[0].second;
+  std::vector<SortingChunk<T> *> sources;
+  for (auto &chunk : chunks) {
+    if (io)
+      chunk->EnablePrefetch(io);
+    sources.push_back(chunk.get());
+  }
+  LoserTree<T, SortingChunk<T>, Compare> tree(sources, compare);
 
-      if (chunks[chunk].ElementsLeft())
-          heap.push_back(min{chunks[chunk].Get(), chunk});
-      std::pop_heap(heap.begin(), heap.end(), std::greater<min>());
+  // Last folded element is held back at the beginning of buffer,
+  // as its series may continue in the next portion
+  T *merged_chunk = new T[portion + 1];
+  size_t held = 0;
+  size_t emitted = 0;
+  while (emitted < limit) {
+    size_t count = tree.Pop(merged_chunk + held, portion);
+    if (!count)
+      break;
 
-      merged_chunk[count] = heap[heap.size() - 1].first;
-      heap.pop_back();
+    if (Reducer::kEnabled) {
+      T *end = Reduce(merged_chunk, merged_chunk + held + count, compare, reducer);
+      count = end - merged_chunk - 1;
     }
 
-    destination->write((char *) merged_chunk, sizeof(T) * chunk_size);
+    count = std::min(count, limit - emitted);
+    output(merged_chunk, count);
+    emitted += count;
+
+    if (Reducer::kEnabled) {
+      merged_chunk[0] = merged_chunk[count];
+      held = 1;
+    }
   }
+  if (held && emitted < limit)
+    output(merged_chunk, 1);
 
   delete []merged_chunk;
 }
 
+// Smallest buffer of every run in each worker of parallel merge;
+// fewer workers merge if memory is not enough for that
+const size_t kMinMergePortion = 1 << 12;
+
+// Number of splitter candidates sampled from runs per merge worker
+const size_t kMergeOversampling = 32;
+
+// Split uncompressed runs placed at given byte offsets of temp into
+// workers_num ranges of about equal size, such that all elements of
+// a range are not less than elements of previous ranges.
+// Equal elements are ordered by run and position, so even long series
+// of them are split between workers; bounds[k][r] is index in run r
+// where range k starts, and the last bounds are lengths of runs
+template <typename T, typename Compare>
+std::vector<std::vector<size_t>> partition_runs(FileMapper<T> *temp, const size_t *offsets,
+                                                const std::vector<size_t> &runs,
+                                                size_t workers_num, Compare compare) {
+  struct Position {
+    T element;
+    size_t run;
+    size_t index;
+  };
+  auto less = [&compare](const Position &a, const Position &b) -> bool {
+    if (compare(a.element, b.element))
+      return true;
+    if (compare(b.element, a.element))
+      return false;
+    return a.run < b.run || (a.run == b.run && a.index < b.index);
+  };
+  auto at = [temp, offsets](size_t run, size_t index) {
+    Position position{T(), run, index};
+    temp->Read(&position.element, 1, offsets[run] / sizeof(T) + index);
+    return position;
+  };
+
+  std::vector<std::vector<size_t>> bounds(workers_num + 1, std::vector<size_t>(runs.size(), 0));
+  bounds[workers_num] = runs;
+
+  const size_t total_count = std::accumulate(runs.begin(), runs.end(), size_t(0));
+  if (!total_count)
+    return bounds;
+
+  // Runs give samples in proportion to their lengths
+  const size_t samples_num = workers_num * kMergeOversampling;
+  std::vector<Position> samples;
+  for (size_t run = 0; run < runs.size(); ++run) {
+    const size_t run_samples = (runs[run] * samples_num + total_count - 1) / total_count;
+    for (size_t i = 0; i < run_samples; ++i)
+      samples.push_back(at(run, (2 * i + 1) * runs[run] / (2 * run_samples)));
+  }
+  std::sort(samples.begin(), samples.end(), less);
+
+  for (size_t k = 1; k < workers_num; ++k) {
+    const Position &splitter = samples[k * samples.size() / workers_num];
+
+    // Find first element of every run which is not less than splitter
+    for (size_t run = 0; run < runs.size(); ++run) {
+      size_t begin = bounds[k - 1][run];
+      size_t end = runs[run];
+      while (begin < end) {
+        const size_t middle = begin + (end - begin) / 2;
+        if (less(at(run, middle), splitter))
+          begin = middle + 1;
+        else
+          end = middle;
+      }
+      bounds[k][run] = begin;
+    }
+  }
+
+  return bounds;
+}
+
+// Merge uncompressed runs with several workers, each taking its own range
+// of elements and writing it to its place in destination
+template <typename T, typename Compare>
+void parallel_merge(FileMapper<T> *temp, const std::vector<size_t> &offsets,
+                    const std::vector<size_t> &runs, size_t workers_num, size_t portion,
+                    thread_pool<void> *io, Compare compare, FileMapper<T> *destination) {
+  const auto bounds = partition_runs(temp, offsets.data(), runs, workers_num, compare);
+
+  // Mapped file grows on writes past its end, which must not happen concurrently
+  if (destination->Mapped())
+    destination->Resize(std::accumulate(runs.begin(), runs.end(), size_t(0)));
+
+  // Calling thread works too while waiting for results
+  thread_pool<void> pool(workers_num - 1);
+  PoolShutdown<void> shutdown(&pool);
+  std::vector<std::future<void>> futures;
+
+  for (size_t k = 0; k < workers_num; ++k) {
+    auto merge = [&bounds, &offsets, &runs, temp, portion, io, compare, destination, k]() {
+      // Range starts in output after all elements of previous ranges
+      size_t position = 0;
+      std::vector<size_t> range_offsets;
+      std::vector<size_t> range_runs;
+      for (size_t run = 0; run < runs.size(); ++run) {
+        position += bounds[k][run];
+        if (bounds[k + 1][run] == bounds[k][run])
+          continue;
+
+        range_offsets.push_back(offsets[run] + bounds[k][run] * sizeof(T));
+        range_runs.push_back(bounds[k + 1][run] - bounds[k][run]);
+      }
+
+      auto output = [destination, &position](const T *elements, size_t count) {
+        destination->Write(elements, count, position);
+        position += count;
+      };
+      merge_runs<T>(temp, range_offsets.data(), range_runs.data(), range_runs.size(),
+                    portion, false, io, compare, NoReducer(), std::numeric_limits<size_t>::max(),
+                    output);
+    };
+    futures.push_back(pool.submit(merge));
+  }
+
+  for (auto &future : futures) {
+    pool.wait(future);
+    future.get();
+  }
+}
+
+// Merge runs described by state in several passes if there are too many
+// of them for merging at once to be efficient, and pass first limit
+// elements of the result to output. If destination is not null, output
+// puts elements into it, and the last pass is split between workers
+// by ranges of elements unless runs are compressed, folded or limited
+template <typename T, typename Compare, typename Reducer>
+void merge_all(FileMapper<T> *temp, FileMapper<T> *spare, MergeState *state,
+               const SortOptions &options, Compare compare, Reducer reducer,
+               FileMapper<T> *destination, const std::function<void(const T *, size_t)> &output,
+               SortStats *stats) {
+  const size_t limit = options.limit ? options.limit : std::numeric_limits<size_t>::max();
+  FileMapper<T> *temps[] = {temp, spare};
+
+  // Every run holds two buffers when they are prefetched, one more
+  // for compressed data, and its reader may decode a block besides
+  const size_t buffers_per_run = (options.io_threads ? 2 : 1) + (options.compressed ? 1 : 0);
+  const size_t run_overhead = RunReader<T>::Overhead(options.compressed);
+  const size_t fan_in = PlanFanIn(state->runs.size(), state->count, sizeof(T), options.memory,
+                                  buffers_per_run, run_overhead, options.device);
+  const size_t portion = MergeBuffer(options.memory, fan_in, buffers_per_run, run_overhead);
+
+  thread_pool<void> io(options.io_threads);
+  PoolShutdown<void> shutdown(&io);
+  thread_pool<void> *prefetch = options.io_threads ? &io : nullptr;
+
+  while (state->runs.size() > fan_in) {
+    FileMapper<T> *source = temps[state->temp];
+    FileMapper<T> *target = temps[1 - state->temp];
+
+    std::vector<size_t> merged_runs;
+    for (size_t first = 0; first < state->runs.size(); first += fan_in) {
+      const size_t last = std::min(first + fan_in, state->runs.size());
+      merged_runs.push_back(std::min(std::accumulate(&state->runs[first], &state->runs[last], size_t(0)),
+                                     limit));
+    }
+
+    // Merged runs are given space for all their elements, though
+    // folding may leave part of it unused
+    auto merged_offsets = run_offsets<T>(merged_runs, options.compressed);
+    if (target->Mapped())
+      target->Resize((merged_offsets.back() + sizeof(T) - 1) / sizeof(T));
+    merged_offsets.pop_back();
+
+    for (size_t i = 0; i < merged_runs.size(); ++i) {
+      const size_t first = i * fan_in;
+      const size_t runs_num = std::min(fan_in, state->runs.size() - first);
+
+      RunWriter<T> writer(target, merged_offsets[i], options.compressed);
+      size_t written = 0;
+      auto output = [&writer, &written](const T *elements, size_t count) {
+        writer.Write(elements, count);
+        written += count;
+      };
+      merge_runs<T>(source, &state->offsets[first], &state->runs[first], runs_num,
+                    portion, options.compressed, prefetch, compare, reducer, limit, output);
+      writer.Close();
+      merged_runs[i] = written;
+    }
+
+    state->runs = merged_runs;
+    state->offsets = merged_offsets;
+    state->temp = 1 - state->temp;
+    ++stats->passes;
+
+    if (!options.state.empty()) {
+      target->Sync();
+      SaveMergeState(options.state, *state);
+    }
+  }
+
+  // Compressed runs can not be searched for range bounds, and size of
+  // folded output is not known beforehand; limited output is small
+  const size_t merge_workers = options.compressed || Reducer::kEnabled || options.limit
+                               ? 1
+                               : std::max<size_t>(std::min(options.workers, portion / kMinMergePortion), 1);
+  if (destination && merge_workers > 1) {
+    parallel_merge(temps[state->temp], state->offsets, state->runs, merge_workers,
+                   portion / merge_workers, prefetch, compare, destination);
+  } else {
+    merge_runs<T>(temps[state->temp], state->offsets.data(), state->runs.data(), state->runs.size(),
+                  portion, options.compressed, prefetch, compare, reducer, limit, output);
+  }
+}
+
+// Start merge state of sorting file with options; it records everything
+// runs depend on, so that state of one sort is not resumed by another
+template <typename T, typename Compare, typename Reducer>
+MergeState new_merge_state(FileMapper<T> *file, const SortOptions &options) {
+  MergeState state;
+  state.count = file->Count();
+  state.compressed = options.compressed;
+  state.reducer = Reducer::Name();
+  state.limit = options.limit;
+  state.element_size = sizeof(T);
+  state.element = typeid(T).name();
+  state.order = typeid(Compare).name();
+  state.input = file->Stamp();
+  state.temp = 0;
+
+  return state;
+}
+
+// Read merge state saved to options.state by interrupted sort of file;
+// if there is none, or it was saved by another sort, whose runs were
+// typed, ordered, folded, cut or compressed differently, state
+// is started anew and false is returned
+template <typename T, typename Compare, typename Reducer>
+bool load_merge_state(FileMapper<T> *file, const SortOptions &options, MergeState *state) {
+  *state = new_merge_state<T, Compare, Reducer>(file, options);
+
+  MergeState saved;
+  if (options.state.empty() || !LoadMergeState(options.state, &saved) || !SameSort(saved, *state))
+    return false;
+
+  *state = saved;
+  return true;
+}
+
+// Put content of file sorted by compare into destination, folding
+// equal elements with reducer; temp and spare are used for sorted chunks storing
+template <typename T, typename Compare = std::less<T>, typename Reducer = NoReducer>
+SortStats external_sort(FileMapper<T> *file, FileMapper<T> *temp, FileMapper<T> *spare,
+                        FileMapper<T> *destination, SortOptions options,
+                        Compare compare = Compare(), Reducer reducer = Reducer()) {
+  assert(options.memory != 0 && options.workers != 0);
+
+  using clock = std::chrono::steady_clock;
+  auto seconds_since = [](clock::time_point start) {
+    return std::chrono::duration<double>(clock::now() - start).count();
+  };
+
+  SortStats stats{0, 0, 0, 1};
+  auto start = clock::now();
+
+  size_t position = 0;
+  auto output = [destination, &position](const T *elements, size_t count) {
+    destination->Write(elements, count, position);
+    position += count;
+  };
+
+  if (options.limit && options.limit <= options.memory / 2) {
+    size_t read = 0;
+    auto input = [file, &read](T *out, size_t count) {
+      const size_t fetched = file->Read(out, count, read);
+      read += fetched;
+      return fetched;
+    };
+    select_smallest<T>(input, options.limit, options.memory, compare, reducer, output);
+    stats.run_generation_time = seconds_since(start);
+    stats.passes = 0;
+    return stats;
+  }
+  const size_t limit = options.limit ? options.limit : std::numeric_limits<size_t>::max();
+
+  MergeState state;
+  const bool resumed = load_merge_state<T, Compare, Reducer>(file, options, &state);
+  if (!resumed) {
+    if (options.replacement_selection) {
+      state.runs = replacement_selection(file, temp, options.memory, options.compressed,
+                                         compare, reducer, limit);
+      state.offsets = run_offsets<T>(state.runs, options.compressed);
+      state.offsets.pop_back();
+    } else {
+      state.runs = generate_runs(file, temp, options, compare, reducer, &state.offsets);
+    }
+
+    if (!options.state.empty()) {
+      temp->Sync();
+      SaveMergeState(options.state, state);
+    }
+  }
+  stats.run_generation_time = seconds_since(start);
+  stats.runs = state.runs.size();
+  start = clock::now();
+
+  merge_all<T>(temp, spare, &state, options, compare, reducer, destination, output, &stats);
+  stats.merge_time = seconds_since(start);
+
+  if (!options.state.empty())
+    std::remove(options.state.c_str());
+
+  return stats;
+}
+
+// Put elements read from input sorted by compare into output, folding
+// equal elements with reducer; temp and spare are used for sorted chunks storing.
+// Input and output may be pipes: runs are spilled to temp as memory fills,
+// and merged elements are written in order. Sort can not be resumed,
+// as input is read only once, so options.state is ignored. Replacement
+// selection reads input file by runs and is not supported here
+template <typename T, typename Compare = std::less<T>, typename Reducer = NoReducer>
+SortStats external_sort(StreamReader<T> *input, FileMapper<T> *temp, FileMapper<T> *spare,
+                        StreamWriter<T> *output, SortOptions options,
+                        Compare compare = Compare(), Reducer reducer = Reducer()) {
+  assert(options.memory != 0 && options.workers != 0);
+  if (options.replacement_selection)
+    throw std::invalid_argument("replacement selection is not supported for streams");
+
+  using clock = std::chrono::steady_clock;
+  auto seconds_since = [](clock::time_point start) {
+    return std::chrono::duration<double>(clock::now() - start).count();
+  };
+
+  SortStats stats{0, 0, 0, 1};
+  auto start = clock::now();
+  options.state.clear();
+
+  auto write = [output](const T *elements, size_t count) {
+    output->Write(elements, count);
+  };
+
+  if (options.limit && options.limit <= options.memory / 2) {
+    auto read = [input](T *out, size_t count) {
+      return input->Read(out, count);
+    };
+    select_smallest<T>(read, options.limit, options.memory, compare, reducer, write);
+    stats.run_generation_time = seconds_since(start);
+    stats.passes = 0;
+    return stats;
+  }
+
+  MergeState state;
+  state.compressed = options.compressed;
+  state.reducer = Reducer::Name();
+  state.limit = options.limit;
+  state.temp = 0;
+  state.runs = stream_runs(input, temp, options, compare, reducer, &state.offsets);
+  state.count = std::accumulate(state.runs.begin(), state.runs.end(), size_t(0));
+
+  stats.run_generation_time = seconds_since(start);
+  stats.runs = state.runs.size();
+  start = clock::now();
+
+  merge_all<T>(temp, spare, &state, options, compare, reducer, nullptr, write, &stats);
+  stats.merge_time = seconds_since(start);
+
+  return stats;
+}
+
 #endif // SORT_H_
@@ -1,52 +1,470 @@
 #ifndef FILE_IO_H_
 #define FILE_IO_H_
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <vector>
+
+// Contiguous range of elements placed directly in mapped file
+template <typename T>
+struct Span {
+  T *begin() const {
+    return data;
+  }
+
+  T *end() const {
+    return data + size;
+  }
+
+  T *data;
+  size_t size;
+};
+
+// Alignment of offsets, sizes and buffers of direct I/O; suits devices
+// with both 512-byte and 4096-byte logical blocks
+const size_t kDirectAlignment = 4096;
+
+// Size of buffers used for direct I/O of unaligned data
+const size_t kDirectBuffer = 1 << 20;
+
+// Aligned buffers of equal size shared by threads doing direct I/O
+class AlignedBufferPool {
+ public:
+  // Buffer taken from pool and given back when it is destroyed
+  class Lease {
+   public:
+    explicit Lease(AlignedBufferPool *pool) : pool_(pool), data_(pool->Take()) {}
+
+    Lease(const Lease &) = delete;
+    Lease & operator=(const Lease &) = delete;
+
+    ~Lease() {
+      pool_->Give(data_);
+    }
+
+    char *data() const {
+      return data_;
+    }
+
+   private:
+    AlignedBufferPool *pool_;
+    char *data_;
+  };
+
+  explicit AlignedBufferPool(size_t size) : size_(size) {}
+
+  AlignedBufferPool(const AlignedBufferPool &) = delete;
+  AlignedBufferPool & operator=(const AlignedBufferPool &) = delete;
+
+  ~AlignedBufferPool() {
+    for (auto buffer : free_)
+      std::free(buffer);
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  char *Take() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_.empty()) {
+      char *buffer = free_.back();
+      free_.pop_back();
+      return buffer;
+    }
+
+    void *buffer;
+    if (::posix_memalign(&buffer, kDirectAlignment, size_))
+      throw std::bad_alloc();
+    return (char *) buffer;
+  }
+
+  void Give(char *buffer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(buffer);
+  }
+
+  size_t size_;
+  std::mutex mutex_;
+  std::vector<char *> free_;
+};
 
 // Allows random access to file as sequence of elements
+// In mapped mode the whole file is mapped into memory, so Read and Write
+// are plain copies and View gives access to elements without copying at all.
+// In direct mode data bypasses page cache: whole aligned blocks are
+// transferred with O_DIRECT, through aligned buffers if necessary, and only
+// unaligned edges of written ranges go through the cache
 template <typename T>
 class FileMapper {
-  static_assert(std::is_arithmetic<T>::value, "Arithmetic types are supported");
+  static_assert(std::is_trivially_copyable<T>::value, "Trivially copyable types are supported");
 
  public:
-  FileMapper(std::string file_name, std::ios::openmode flags)
-    : stream_(file_name, std::ios::in | std::ios::out | flags) {
-    if (Size() % sizeof(T))
+  enum class Mode { kStream, kMapped, kDirect };
+
+  FileMapper(std::string file_name, std::ios::openmode flags, Mode mode = Mode::kStream)
+    : fd_(::open(file_name.c_str(), O_RDWR | (flags & std::ios::trunc ? O_CREAT | O_TRUNC : 0), 0644)),
+      direct_fd_(-1),
+      mode_(mode),
+      map_(nullptr),
+      map_size_(0),
+      size_(0),
+      bytes_read_(0),
+      bytes_written_(0) {
+    if (fd_ < 0)
+      throw std::runtime_error("cannot open " + file_name);
+    if (FileSize() % sizeof(T)) {
+      ::close(fd_);
       throw std::invalid_argument("file is corrupted");
+    }
+
+    if (Mapped()) {
+      Map();
+      size_ = map_size_;
+    }
+
+    if (Direct()) {
+      direct_fd_ = ::open(file_name.c_str(), O_RDWR | O_DIRECT);
+      if (direct_fd_ < 0) {
+        ::close(fd_);
+        throw std::runtime_error("direct I/O is not supported for " + file_name);
+      }
+      buffers_.reset(new AlignedBufferPool(kDirectBuffer));
+    }
+  }
+
+  explicit FileMapper(std::string file_name, Mode mode = Mode::kStream)
+    : FileMapper(file_name, std::ios::openmode(), mode) {}
+
+  FileMapper(const FileMapper &) = delete;
+  FileMapper & operator=(const FileMapper &) = delete;
+
+  ~FileMapper() {
+    const bool reserved = map_size_ > size_;
+    Unmap();
+    // Space reserved for growth of mapped file is cut off;
+    // if that fails, it just stays in file
+    if (reserved && ::ftruncate(fd_, size_)) {}
+    if (direct_fd_ >= 0)
+      ::close(direct_fd_);
+    ::close(fd_);
   }
 
-  FileMapper(std::string file_name) : FileMapper(file_name, std::ios::openmode()) {}
+  // Check if elements are accessed through memory mapping
+  bool Mapped() const {
+    return mode_ == Mode::kMapped;
+  }
+
+  // Check if page cache is bypassed
+  bool Direct() const {
+    return mode_ == Mode::kDirect;
+  }
+
+  // Get number of bytes passed through Read and Write;
+  // elements accessed through views are not counted
+  size_t BytesRead() const {
+    return bytes_read_;
+  }
+
+  size_t BytesWritten() const {
+    return bytes_written_;
+  }
 
   // Get number of elements in file
   size_t Count() {
     return Size() / sizeof(T);
   }
 
+  // Get device, inode, size and modification time of file;
+  // stamp changes when file is replaced or written
+  std::string Stamp() {
+    struct stat info;
+    if (::fstat(fd_, &info))
+      throw std::runtime_error("stat failed");
+    return std::to_string(info.st_dev) + ':' + std::to_string(info.st_ino) + ':'
+           + std::to_string(info.st_size) + ':' + std::to_string(info.st_mtim.tv_sec) + '.'
+           + std::to_string(info.st_mtim.tv_nsec);
+  }
+
   // Read count elements starting from offset into s
   size_t Read(T *s, size_t count, size_t offset) {
-    stream_.clear();
-    stream_.seekg(offset * sizeof(T), std::ios::beg);
-    stream_.read((char *) s, count * sizeof(T));
-    return stream_.gcount() / sizeof(T);
+    return ReadBytes(s, count * sizeof(T), offset * sizeof(T)) / sizeof(T);
   }
 
   // Write count elements from s into file starting from offset
-  void Write(T *s, size_t count, size_t offset) {
-    stream_.clear();
-    stream_.seekp(offset * sizeof(T), std::ios::beg);
-    stream_.write((char *) s, count * sizeof(T));
-    stream_.flush();
+  void Write(const T *s, size_t count, size_t offset) {
+    WriteBytes(s, count * sizeof(T), offset * sizeof(T));
+  }
+
+  // Read raw bytes starting from byte offset; used for data
+  // not split into elements, such as compressed runs
+  size_t ReadBytes(void *s, size_t size, size_t offset) {
+    if (Mapped()) {
+      const size_t available = offset < size_ ? size_ - offset : 0;
+      if (size > available)
+        size = available;
+      if (size)
+        std::memcpy(s, map_ + offset, size);
+      bytes_read_ += size;
+      return size;
+    }
+
+    const size_t fetched = Direct() ? ReadDirect((char *) s, size, offset)
+                                    : ReadFully(fd_, (char *) s, size, offset);
+    bytes_read_ += fetched;
+    return fetched;
+  }
+
+  // Write raw bytes starting from byte offset
+  void WriteBytes(const void *s, size_t size, size_t offset) {
+    bytes_written_ += size;
+    if (Mapped()) {
+      if (offset + size > size_)
+        Grow(offset + size);
+      std::memcpy(map_ + offset, s, size);
+      return;
+    }
+
+    if (Direct())
+      WriteDirect((const char *) s, size, offset);
+    else
+      WriteFully(fd_, (const char *) s, size, offset);
+  }
+
+  // Set number of elements in file; remaps the file in mapped mode,
+  // so it must not be called while views are in use
+  void Resize(size_t count) {
+    if (::ftruncate(fd_, count * sizeof(T)))
+      throw std::runtime_error("resize failed");
+
+    if (Mapped()) {
+      Unmap();
+      Map();
+      size_ = map_size_;
+    }
+  }
+
+  // Tell kernel that byte range is not going to be read again,
+  // so its pages may leave page cache; mapped file is left as is
+  void Release(size_t offset, size_t size) {
+    if (!Mapped() && size)
+      ::posix_fadvise(fd_, offset, size, POSIX_FADV_DONTNEED);
+  }
+
+  // Make sure written elements reach the disk
+  void Sync() {
+    if (Mapped() && map_ && ::msync(map_, map_size_, MS_SYNC))
+      throw std::runtime_error("sync failed");
+    if (::fdatasync(fd_))
+      throw std::runtime_error("sync failed");
+  }
+
+  // Get count elements starting from offset without copying;
+  // available only in mapped mode
+  Span<T> View(size_t count, size_t offset) {
+    if (!Mapped())
+      throw std::logic_error("file is not mapped");
+
+    const size_t available = offset < MappedCount() ? MappedCount() - offset : 0;
+    if (count > available)
+      count = available;
+
+    Span<T> span{Data() + offset, count};
+    Advise(span, MADV_WILLNEED);
+
+    return span;
   }
 
  private:
-  // Get file size in bytes
+  static bool Aligned(size_t value) {
+    return value % kDirectAlignment == 0;
+  }
+
+  static size_t AlignDown(size_t value) {
+    return value - value % kDirectAlignment;
+  }
+
+  static size_t AlignUp(size_t value) {
+    return AlignDown(value + kDirectAlignment - 1);
+  }
+
+  // Read until size bytes are read or file ends; returns number of read bytes
+  static size_t ReadFully(int fd, char *buffer, size_t size, size_t offset) {
+    size_t done = 0;
+    while (done < size) {
+      ssize_t fetched = ::pread(fd, buffer + done, size - done, offset + done);
+      if (fetched < 0)
+        throw std::runtime_error("read failed");
+      if (fetched == 0)
+        break;
+      done += fetched;
+    }
+
+    return done;
+  }
+
+  static void WriteFully(int fd, const char *buffer, size_t size, size_t offset) {
+    size_t done = 0;
+    while (done < size) {
+      ssize_t written = ::pwrite(fd, buffer + done, size - done, offset + done);
+      if (written < 0)
+        throw std::runtime_error("write failed");
+      done += written;
+    }
+  }
+
+  // Read whole aligned blocks covering the range, through aligned buffer
+  // unless the range is aligned itself; direct reads stop at end of file
+  size_t ReadDirect(char *s, size_t size, size_t offset) {
+    if (Aligned((size_t) s) && Aligned(size) && Aligned(offset))
+      return ReadFully(direct_fd_, s, size, offset);
+
+    AlignedBufferPool::Lease buffer(buffers_.get());
+    size_t done = 0;
+    while (done < size) {
+      const size_t position = offset + done;
+      const size_t begin = AlignDown(position);
+      const size_t end = std::min(AlignUp(offset + size), begin + buffers_->size());
+
+      const size_t fetched = ReadFully(direct_fd_, buffer.data(), end - begin, begin);
+      if (fetched <= position - begin)
+        break;
+
+      const size_t taken = std::min(size - done, fetched - (position - begin));
+      std::memcpy(s + done, buffer.data() + (position - begin), taken);
+      done += taken;
+      if (fetched < end - begin)
+        break;
+    }
+
+    return done;
+  }
+
+  // Write whole aligned blocks of the range directly; partial blocks
+  // at its edges may be shared with other writers, so they are written
+  // through page cache, which keeps concurrent writes to them consistent
+  void WriteDirect(const char *s, size_t size, size_t offset) {
+    const size_t begin = std::min(AlignUp(offset), offset + size);
+    const size_t end = std::max(AlignDown(offset + size), begin);
+
+    WriteFully(fd_, s, begin - offset, offset);
+    WriteFully(fd_, s + (end - offset), offset + size - end, end);
+    if (begin == end)
+      return;
+
+    const char *middle = s + (begin - offset);
+    if (Aligned((size_t) middle)) {
+      WriteFully(direct_fd_, middle, end - begin, begin);
+      return;
+    }
+
+    AlignedBufferPool::Lease buffer(buffers_.get());
+    for (size_t done = 0; done < end - begin; done += buffers_->size()) {
+      const size_t portion = std::min(end - begin - done, buffers_->size());
+      std::memcpy(buffer.data(), middle + done, portion);
+      WriteFully(direct_fd_, buffer.data(), portion, begin + done);
+    }
+  }
+
+  // Get size of elements in file in bytes; mapped file may be larger
   size_t Size() {
-    stream_.seekg(0, std::ios::end);
-    return stream_.tellg();
+    return Mapped() ? size_ : FileSize();
+  }
+
+  size_t FileSize() {
+    struct stat info;
+    if (::fstat(fd_, &info))
+      throw std::runtime_error("stat failed");
+    return info.st_size;
+  }
+
+  T *Data() {
+    return (T *) map_;
+  }
+
+  // Get number of mapped elements without asking the kernel
+  size_t MappedCount() const {
+    return size_ / sizeof(T);
+  }
+
+  void Map() {
+    map_size_ = FileSize();
+    if (!map_size_)
+      return;
+
+    void *map = ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED)
+      throw std::runtime_error("mmap failed");
+    map_ = (char *) map;
+
+    // Both sorting and merging walk through the file front to back
+    ::madvise(map_, map_size_, MADV_SEQUENTIAL);
+  }
+
+  // Extend mapped file to hold size bytes; file and mapping grow at least
+  // twice, so that appending in small pieces remaps it only
+  // logarithmic number of times
+  void Grow(size_t size) {
+    if (size > map_size_) {
+      size_t capacity = std::max(size, map_size_ * 2);
+      capacity += (sizeof(T) - capacity % sizeof(T)) % sizeof(T);
+      if (::ftruncate(fd_, capacity))
+        throw std::runtime_error("resize failed");
+
+      Unmap();
+      Map();
+    }
+    size_ = size;
+  }
+
+  void Unmap() {
+    if (map_)
+      ::munmap(map_, map_size_);
+    map_ = nullptr;
+    map_size_ = 0;
   }
 
-  std::fstream stream_;
+  // Give kernel a hint about span; range is widened to page boundaries
+  void Advise(Span<T> span, int advice) {
+    if (!span.size)
+      return;
+
+    const size_t page = ::sysconf(_SC_PAGESIZE);
+    size_t begin = (char *) span.begin() - map_;
+    size_t end = (char *) span.end() - map_;
+    begin -= begin % page;
+
+    ::madvise(map_ + begin, end - begin, advice);
+  }
+
+  int fd_;
+  // Descriptor opened with O_DIRECT in direct mode, -1 otherwise
+  int direct_fd_;
+  Mode mode_;
+  char *map_;
+  size_t map_size_;
+  // Bytes of mapped file in use; rest of mapping is reserved for growth
+  size_t size_;
+
+  // Buffers for direct I/O of unaligned ranges
+  std::unique_ptr<AlignedBufferPool> buffers_;
+
+  std::atomic<size_t> bytes_read_;
+  std::atomic<size_t> bytes_written_;
 };
 
 #endif // FILE_IO_H_
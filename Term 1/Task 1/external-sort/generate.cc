@@ -0,0 +1,75 @@
+#include <unistd.h>
+
+#include <cstdint>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include "generator.h"
+#include "record.h"
+#include "util.h"
+
+template <typename T>
+void GenerateFile(Distribution distribution, size_t size, unsigned seed, const std::string &file) {
+  std::ofstream output(file, std::ios::binary | std::ios::trunc);
+  Generate<T>(distribution, size / sizeof(T), seed, &output);
+}
+
+int main(int argc, char **argv) {
+  std::string type = "char";
+  unsigned seed = 0;
+
+  int option;
+  while ((option = ::getopt(argc, argv, "e:s:")) != -1) {
+    switch (option) {
+      case 'e':
+        type = optarg;
+        break;
+
+      case 's':
+        seed = std::stoul(optarg);
+        break;
+
+      default:
+        return 1;
+    }
+  }
+
+  if (argc - optind < 3) {
+    std::cout << "Usage: " << argv[0] << " [-e TYPE] [-s SEED] DISTRIBUTION SIZE FILE" << std::endl
+              << "  -e  type of elements: char (default), int32, int64, uint64, double or record" << std::endl
+              << "  -s  seed of random generator" << std::endl
+              << "  DISTRIBUTION is uniform, sorted, reverse, few-unique or zipf;" << std::endl
+              << "  SIZE is in bytes and is rounded down to whole elements" << std::endl;
+
+    return 0;
+  }
+
+  Distribution distribution;
+  if (!ParseDistribution(argv[optind], &distribution)) {
+    std::cout << "Unknown distribution " << argv[optind] << std::endl;
+    return 1;
+  }
+  const size_t size = ParseSize(argv[optind + 1]);
+  const std::string file = argv[optind + 2];
+
+  if (type == "char") {
+    GenerateFile<char>(distribution, size, seed, file);
+  } else if (type == "int32") {
+    GenerateFile<int32_t>(distribution, size, seed, file);
+  } else if (type == "int64") {
+    GenerateFile<int64_t>(distribution, size, seed, file);
+  } else if (type == "uint64") {
+    GenerateFile<uint64_t>(distribution, size, seed, file);
+  } else if (type == "double") {
+    GenerateFile<double>(distribution, size, seed, file);
+  } else if (type == "record") {
+    GenerateFile<KeyedRecord>(distribution, size, seed, file);
+  } else {
+    std::cout << "Unknown type " << type << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
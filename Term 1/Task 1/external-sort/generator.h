@@ -0,0 +1,147 @@
+#ifndef GENERATOR_H_
+#define GENERATOR_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include <fstream>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "radix_sort.h"
+#include "record.h"
+
+// Kinds of generated input
+enum class Distribution { kUniform, kSorted, kReverse, kFewUnique, kZipf, kDistributionNum };
+
+// Number of distinct values in few-unique input
+const uint64_t kFewUniqueValues = 16;
+
+// Number of distinct values in Zipf input; k-th most frequent value
+// appears about 1/k as often as the most frequent one
+const size_t kZipfValues = 1 << 16;
+
+inline const char *DistributionName(Distribution distribution) {
+  static const char *kNames[] = {"uniform", "sorted", "reverse", "few-unique", "zipf"};
+  return kNames[static_cast<int>(distribution)];
+}
+
+// Find distribution by its name; returns false if there is no such
+inline bool ParseDistribution(const std::string &name, Distribution *distribution) {
+  for (int i = 0; i < static_cast<int>(Distribution::kDistributionNum); ++i) {
+    if (name == DistributionName(static_cast<Distribution>(i))) {
+      *distribution = static_cast<Distribution>(i);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Scatter small numbers over the whole 64-bit range
+inline uint64_t Mix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+  return x ^ (x >> 31);
+}
+
+// Builds elements from 64-bit numbers so that order of numbers
+// is kept (though close numbers may give equal elements)
+template <typename T>
+struct ElementMaker {
+  static_assert(std::is_arithmetic<T>::value, "Arithmetic types or records are supported");
+
+  static T Make(uint64_t x, std::mt19937_64 &) {
+    return Make(x, std::is_floating_point<T>());
+  }
+
+  static T Make(uint64_t x, std::true_type) {
+    return T(x / 18446744073709551616.0 * 2e9 - 1e9);
+  }
+
+  static T Make(uint64_t x, std::false_type) {
+    using Bits = typename UnsignedOf<sizeof(T)>::type;
+
+    Bits bits = Bits(x >> (64 - 8 * sizeof(T)));
+    if (std::is_signed<T>::value)
+      bits ^= Bits(1) << (8 * sizeof(T) - 1);
+
+    T element;
+    std::memcpy(&element, &bits, sizeof(T));
+    return element;
+  }
+};
+
+// Number becomes beginning of key, the rest of record is random
+template <size_t size>
+struct ElementMaker<Record<size>> {
+  static Record<size> Make(uint64_t x, std::mt19937_64 &random) {
+    Record<size> record;
+    for (auto &byte : record.bytes)
+      byte = random();
+    for (size_t i = 0; i < 8 && i < size; ++i)
+      record.bytes[i] = x >> (56 - 8 * i);
+
+    return record;
+  }
+};
+
+// Write count elements of given distribution to output
+template <typename T>
+void Generate(Distribution distribution, size_t count, unsigned seed, std::ostream *output) {
+  const size_t kBuffer = 1 << 16;
+
+  std::mt19937_64 random(seed);
+  std::discrete_distribution<size_t> zipf;
+  if (distribution == Distribution::kZipf) {
+    std::vector<double> weights(kZipfValues);
+    for (size_t i = 0; i < kZipfValues; ++i)
+      weights[i] = 1.0 / (i + 1);
+    zipf = std::discrete_distribution<size_t>(weights.begin(), weights.end());
+  }
+
+  const uint64_t step = count ? UINT64_MAX / count : 0;
+
+  std::vector<T> buffer;
+  buffer.reserve(kBuffer);
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t x = 0;
+    switch (distribution) {
+      case Distribution::kUniform:
+        x = random();
+        break;
+
+      case Distribution::kSorted:
+        x = i * step;
+        break;
+
+      case Distribution::kReverse:
+        x = (count - 1 - i) * step;
+        break;
+
+      case Distribution::kFewUnique:
+        x = random() % kFewUniqueValues * (UINT64_MAX / kFewUniqueValues);
+        break;
+
+      case Distribution::kZipf:
+        x = Mix(zipf(random));
+        break;
+
+      default:
+        break;
+    }
+
+    buffer.push_back(ElementMaker<T>::Make(x, random));
+    if (buffer.size() == kBuffer) {
+      output->write((const char *) buffer.data(), buffer.size() * sizeof(T));
+      buffer.clear();
+    }
+  }
+
+  output->write((const char *) buffer.data(), buffer.size() * sizeof(T));
+}
+
+#endif // GENERATOR_H_
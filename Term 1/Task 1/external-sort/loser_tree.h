@@ -0,0 +1,123 @@
+#ifndef LOSER_TREE_H_
+#define LOSER_TREE_H_
+
+#include <functional>
+#include <vector>
+
+#include "file_mapper.h"
+
+// Merges sorted sources with tournament tree of losers:
+// each extracted element costs ceil(log k) comparisons for k sources
+// Source must provide Span<T> Fetch() returning next batch of its elements
+// (empty when source is exhausted); batch has to stay valid until next Fetch
+template <typename T, typename Source, typename Compare = std::less<T>>
+class LoserTree {
+ public:
+  explicit LoserTree(const std::vector<Source *> &sources, Compare compare = Compare())
+    : leaves_(sources.size()),
+      losers_(sources.size()),
+      compare_(compare) {
+    for (size_t i = 0; i < leaves_.size(); ++i) {
+      leaves_[i].source = sources[i];
+      Refill(leaves_[i]);
+    }
+
+    Build();
+  }
+
+  // Check if all sources are exhausted
+  bool Empty() const {
+    return leaves_.empty() || Exhausted(winner_);
+  }
+
+  // Put up to count smallest elements into out; returns number of extracted
+  size_t Pop(T *out, size_t count) {
+    const size_t leaves_num = leaves_.size();
+    size_t extracted = 0;
+
+    while (extracted < count && !Empty()) {
+      Leaf &leaf = leaves_[winner_];
+      out[extracted++] = *leaf.position;
+      if (++leaf.position == leaf.end)
+        Refill(leaf);
+
+      // Replay matches on the path from winner's leaf to the root
+      size_t winner = winner_;
+      for (size_t node = (winner + leaves_num) / 2; node > 0; node /= 2) {
+        if (Less(losers_[node], winner))
+          std::swap(losers_[node], winner);
+      }
+      winner_ = winner;
+    }
+
+    return extracted;
+  }
+
+ private:
+  struct Leaf {
+    Source *source;
+    T *position;
+    T *end;
+  };
+
+  // Load next batch of source; leaf stays empty if source is exhausted
+  void Refill(Leaf &leaf) {
+    Span<T> batch = leaf.source->Fetch();
+    leaf.position = batch.begin();
+    leaf.end = batch.end();
+  }
+
+  bool Exhausted(size_t leaf) const {
+    return leaves_[leaf].position == leaves_[leaf].end;
+  }
+
+  // Compare heads of leaves; exhausted leaves are greater than others
+  // and ties are broken by index to make the order strict
+  bool Less(size_t a, size_t b) const {
+    if (Exhausted(a))
+      return false;
+    if (Exhausted(b))
+      return true;
+
+    const T &x = *leaves_[a].position;
+    const T &y = *leaves_[b].position;
+    if (compare_(x, y))
+      return true;
+    if (compare_(y, x))
+      return false;
+    return a < b;
+  }
+
+  // Play the whole tournament; leaf i is node k + i of implicit binary tree
+  void Build() {
+    const size_t leaves_num = leaves_.size();
+    if (!leaves_num)
+      return;
+
+    std::vector<size_t> winners(2 * leaves_num);
+    for (size_t i = 0; i < leaves_num; ++i)
+      winners[leaves_num + i] = i;
+
+    for (size_t node = leaves_num - 1; node > 0; --node) {
+      size_t left = winners[2 * node];
+      size_t right = winners[2 * node + 1];
+      if (Less(left, right)) {
+        winners[node] = left;
+        losers_[node] = right;
+      } else {
+        winners[node] = right;
+        losers_[node] = left;
+      }
+    }
+
+    winner_ = winners[1];
+  }
+
+  std::vector<Leaf> leaves_;
+  // Loser of the match played in each internal node; node 0 is unused
+  std::vector<size_t> losers_;
+  size_t winner_;
+  Compare compare_;
+};
+
+#endif // LOSER_TREE_H_
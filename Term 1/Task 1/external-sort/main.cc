@@ -1,28 +1,283 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+
 #include <iostream>
-#include <fstream>
+#include <string>
+#include <thread>
 
 #include "external_sort.h"
 #include "util.h"
 #include "file_mapper.h"
+#include "record.h"
+#include "reducer.h"
+#include "stream.h"
+
+// Command line arguments not passed to external sort directly
+struct Arguments {
+  std::string file;
+  std::string destination;
+  // Memory limit in bytes
+  size_t memory;
+  bool mapped;
+  bool direct;
+  // Name of reducer folding equal elements; empty if they are kept
+  std::string reducer;
+  // Size of output in bytes; zero if the whole input is put there
+  size_t output_size;
+};
+
+// Name of file standing for standard input or output
+const char *kStandardStream = "-";
+
+// Open descriptor for streaming sort; standard streams are used for "-"
+int OpenStream(const std::string &name, int standard, int flags) {
+  if (name == kStandardStream)
+    return standard;
+
+  const int fd = ::open(name.c_str(), flags, 0644);
+  if (fd < 0)
+    throw std::runtime_error("cannot open " + name);
+  return fd;
+}
 
-using type = char;
+template <typename T, typename Compare = std::less<T>, typename Reducer = NoReducer>
+void Sort(const Arguments &arguments, SortOptions options) {
+  auto mode = FileMapper<T>::Mode::kStream;
+  if (arguments.mapped)
+    mode = FileMapper<T>::Mode::kMapped;
+  else if (arguments.direct)
+    mode = FileMapper<T>::Mode::kDirect;
+
+  options.memory = std::max<size_t>(arguments.memory / sizeof(T), 1);
+  if (arguments.output_size) {
+    // Output has at least one element
+    const size_t count = std::max<size_t>(arguments.output_size / sizeof(T), 1);
+    options.limit = options.limit ? std::min(options.limit, count) : count;
+  }
+
+  if (arguments.file == kStandardStream || arguments.destination == kStandardStream) {
+    // Runs of stream are written while it is read, so temp is not mapped
+    const auto temp_mode = arguments.direct ? FileMapper<T>::Mode::kDirect : FileMapper<T>::Mode::kStream;
+    FileMapper<T> temp("temp", std::ios::trunc, temp_mode);
+    FileMapper<T> spare("temp.spare", std::ios::trunc, temp_mode);
+
+    const int input = OpenStream(arguments.file, STDIN_FILENO, O_RDONLY);
+    const int output = OpenStream(arguments.destination, STDOUT_FILENO,
+                                  O_WRONLY | O_CREAT | O_TRUNC);
+    StreamReader<T> reader(input);
+    StreamWriter<T> writer(output);
+
+    external_sort(&reader, &temp, &spare, &writer, options, Compare(), Reducer());
+
+    if (input != STDIN_FILENO)
+      ::close(input);
+    if (output != STDOUT_FILENO)
+      ::close(output);
+    return;
+  }
+
+  FileMapper<T> file(arguments.file, mode);
+
+  // Temporary files are kept when sort is resumed; state left by
+  // sort with other options is dropped along with its runs
+  MergeState state;
+  const bool resume = load_merge_state<T, Compare, Reducer>(&file, options, &state);
+  if (!resume && !options.state.empty())
+    std::remove(options.state.c_str());
+  const auto temp_flags = resume ? std::ios::openmode() : std::ios::trunc;
+  FileMapper<T> temp("temp", temp_flags, mode);
+  FileMapper<T> spare("temp.spare", temp_flags, mode);
+  FileMapper<T> destination(arguments.destination, std::ios::trunc,
+                            arguments.direct ? FileMapper<T>::Mode::kDirect : FileMapper<T>::Mode::kStream);
+
+  external_sort(&file, &temp, &spare, &destination, options, Compare(), Reducer());
+}
+
+// Sort with reducer chosen by name; returns false if it is not known
+template <typename T, typename Compare = std::less<T>>
+bool SortReduced(const Arguments &arguments, const SortOptions &options) {
+  if (arguments.reducer.empty()) {
+    Sort<T, Compare>(arguments, options);
+  } else if (arguments.reducer == "unique") {
+    Sort<T, Compare, UniqueReducer>(arguments, options);
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+// Records also may be counted and summed by key
+bool SortRecords(const Arguments &arguments, const SortOptions &options) {
+  if (arguments.reducer == "count") {
+    Sort<KeyedRecord, KeyedRecordLess, KeyedRecordCount>(arguments, options);
+  } else if (arguments.reducer == "sum") {
+    Sort<KeyedRecord, KeyedRecordLess, KeyedRecordSum>(arguments, options);
+  } else {
+    return SortReduced<KeyedRecord, KeyedRecordLess>(arguments, options);
+  }
+
+  return true;
+}
 
 int main(int argc, char **argv) {
-  if (argc < 4) {
-    std::cout << "Usage: " << argv[0] << " FILE DEST CHUNK" << std::endl;
-    
+  bool mapped = false;
+  bool direct = false;
+  std::string type = "char";
+  size_t workers = std::max(std::thread::hardware_concurrency(), 1u);
+  bool replacement = false;
+  bool compressed = false;
+  size_t io_threads = 2;
+  // Defaults describe an ordinary SSD
+  DeviceProfile device{0.0001, 500.0 * (1 << 20)};
+  std::string state;
+  std::string reducer;
+  size_t limit = 0;
+  size_t output_size = 0;
+
+  int option;
+  while ((option = ::getopt(argc, argv, "e:mdj:rzp:t:b:s:R:k:n:")) != -1) {
+    switch (option) {
+      case 'e':
+        type = optarg;
+        break;
+
+      case 'm':
+        mapped = true;
+        break;
+
+      case 'd':
+        direct = true;
+        break;
+
+      case 'j':
+        workers = std::max(std::stoi(optarg), 1);
+        break;
+
+      case 'r':
+        replacement = true;
+        break;
+
+      case 'z':
+        compressed = true;
+        break;
+
+      case 'p':
+        io_threads = std::max(std::stoi(optarg), 0);
+        break;
+
+      case 't':
+        device.seek_time = std::stod(optarg) / 1000;
+        break;
+
+      case 'b':
+        device.bandwidth = ParseSize(optarg);
+        break;
+
+      case 's':
+        state = optarg;
+        break;
+
+      case 'R':
+        reducer = optarg;
+        break;
+
+      case 'k':
+        limit = ParseSize(optarg);
+        break;
+
+      case 'n':
+        output_size = ParseSize(optarg);
+        break;
+
+      default:
+        return 1;
+    }
+  }
+
+  if (argc - optind < 3) {
+    std::cout << "Usage: " << argv[0] << " [-e TYPE] [-m | -d] [-j WORKERS] [-r] [-z] [-p THREADS] [-t SEEK_MS] [-b BANDWIDTH] [-s STATE] [-R REDUCER] [-k COUNT | -n SIZE]"
+              << " FILE DEST MEMORY" << std::endl
+              << "  -e  type of elements: char (default), int32, int64, uint64, double" << std::endl
+              << "      or record (64-byte records ordered by first 16 bytes)" << std::endl
+              << "  -m  access input and temporary files through mmap" << std::endl
+              << "  -d  bypass page cache with direct I/O for all files" << std::endl
+              << "  -j  number of threads generating sorted runs and merging them" << std::endl
+              << "      (all cores by default); MEMORY is split between them" << std::endl
+              << "  -r  generate runs of about twice MEMORY with replacement selection" << std::endl
+              << "      in single thread; not supported for standard streams" << std::endl
+              << "  -z  compress runs in temporary files; not supported for records" << std::endl
+              << "  -p  number of threads prefetching merge buffers (2 by default);" << std::endl
+              << "      0 disables prefetching" << std::endl
+              << "  -t  average seek time of temporary storage in milliseconds" << std::endl
+              << "  -b  bandwidth of temporary storage in bytes per second" << std::endl
+              << "  -s  save progress between merge passes to STATE;" << std::endl
+              << "      sort is resumed if STATE exists" << std::endl
+              << "  -R  fold equal elements: unique keeps one of them;" << std::endl
+              << "      for records count puts number of records with the same key" << std::endl
+              << "      into 8 bytes following key, and sum adds up those bytes" << std::endl
+              << "  -k  put only COUNT smallest elements into DEST" << std::endl
+              << "  -n  put only first SIZE bytes of sorted elements into DEST" << std::endl
+              << "  FILE or DEST may be - for standard input or output; then input" << std::endl
+              << "  is read once and may be a pipe, and sort can not be resumed" << std::endl;
+
     return 0;
   }
 
-  FileMapper<type> file(argv[1]);
+  Arguments arguments;
+  arguments.file = argv[optind];
+  arguments.destination = argv[optind + 1];
+  arguments.memory = ParseSize(argv[optind + 2]);
+  arguments.mapped = mapped;
+  arguments.direct = direct;
+  arguments.reducer = reducer;
+  arguments.output_size = output_size;
 
-  const size_t chunk_memory = ParseSize(argv[3]);
-  const size_t chunk_size = chunk_memory / sizeof(type);
+  if (compressed && type == "record") {
+    std::cout << "Compression is not supported for " << type << std::endl;
+    return 1;
+  }
+
+  if (replacement && (arguments.file == kStandardStream
+                      || arguments.destination == kStandardStream)) {
+    std::cout << "Replacement selection is not supported for standard streams" << std::endl;
+    return 1;
+  }
 
-  FileMapper<type> temp("temp", std::ios::trunc);
-  std::ofstream destination(argv[2]);
+  SortOptions options;
+  options.workers = workers;
+  options.replacement_selection = replacement;
+  options.compressed = compressed;
+  options.io_threads = io_threads;
+  options.device = device;
+  options.state = state;
+  options.limit = limit;
 
-  external_sort(&file, &temp, &destination, chunk_size);
+  bool sorted;
+  if (type == "char") {
+    sorted = SortReduced<char>(arguments, options);
+  } else if (type == "int32") {
+    sorted = SortReduced<int32_t>(arguments, options);
+  } else if (type == "int64") {
+    sorted = SortReduced<int64_t>(arguments, options);
+  } else if (type == "uint64") {
+    sorted = SortReduced<uint64_t>(arguments, options);
+  } else if (type == "double") {
+    sorted = SortReduced<double>(arguments, options);
+  } else if (type == "record") {
+    sorted = SortRecords(arguments, options);
+  } else {
+    std::cout << "Unknown type " << type << std::endl;
+    return 1;
+  }
+
+  if (!sorted) {
+    std::cout << "Reducer " << reducer << " is not supported for " << type << std::endl;
+    return 1;
+  }
 
   return 0;
 }
@@ -0,0 +1,94 @@
+#include "merge_plan.h"
+
+#include <cstdio>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+// Number of passes needed to merge runs_num runs fan_in at a time
+static size_t CountPasses(size_t runs_num, size_t fan_in) {
+  size_t passes = 1;
+  for (; runs_num > fan_in; ++passes)
+    runs_num = (runs_num + fan_in - 1) / fan_in;
+
+  return passes;
+}
+
+size_t MergeBuffer(size_t memory, size_t fan_in, size_t buffers_per_run, size_t run_overhead) {
+  const size_t overhead = fan_in * run_overhead;
+  const size_t available = memory > overhead ? memory - overhead : 0;
+
+  return std::max<size_t>(available / (fan_in * buffers_per_run + 1), 1);
+}
+
+size_t PlanFanIn(size_t runs_num, size_t count, size_t element_size, size_t memory,
+                 size_t buffers_per_run, size_t run_overhead, DeviceProfile device) {
+  const double bytes = (double) count * element_size;
+
+  size_t best = 2;
+  double best_time = -1;
+  for (size_t fan_in = 2; fan_in <= std::max<size_t>(runs_num, 2); ++fan_in) {
+    // Every pass reads and writes everything in portions of buffer size
+    const size_t buffer = MergeBuffer(memory, fan_in, buffers_per_run, run_overhead);
+    const double seeks = 2.0 * count / buffer;
+    const double pass_time = 2 * bytes / device.bandwidth + seeks * device.seek_time;
+    const double time = CountPasses(runs_num, fan_in) * pass_time;
+
+    // Prefer fewer passes if estimations are equal
+    if (best_time < 0 || time <= best_time) {
+      best = fan_in;
+      best_time = time;
+    }
+  }
+
+  return best;
+}
+
+bool LoadMergeState(const std::string &path, MergeState *state) {
+  std::ifstream input(path);
+  size_t runs_num;
+  if (!(input >> state->count >> state->compressed >> state->reducer >> state->limit
+        >> state->element_size >> state->element >> state->order >> state->input
+        >> state->temp >> runs_num))
+    return false;
+
+  state->runs.resize(runs_num);
+  state->offsets.resize(runs_num);
+  for (size_t i = 0; i < runs_num; ++i) {
+    if (!(input >> state->runs[i] >> state->offsets[i]))
+      return false;
+  }
+
+  return true;
+}
+
+void SaveMergeState(const std::string &path, const MergeState &state) {
+  const std::string temp_path = path + ".tmp";
+  {
+    std::ofstream output(temp_path);
+    output << state.count << ' ' << state.compressed << ' ' << state.reducer << ' '
+           << state.limit << ' ' << state.element_size << ' ' << state.element << ' '
+           << state.order << ' ' << state.input << ' ' << state.temp << ' '
+           << state.runs.size() << std::endl;
+    for (size_t i = 0; i < state.runs.size(); ++i)
+      output << state.runs[i] << ' ' << state.offsets[i] << std::endl;
+
+    if (!output)
+      throw std::runtime_error("cannot save merge state");
+  }
+
+  if (std::rename(temp_path.c_str(), path.c_str()))
+    throw std::runtime_error("cannot save merge state");
+}
+
+bool SameSort(const MergeState &first, const MergeState &second) {
+  return first.count == second.count
+         && first.compressed == second.compressed
+         && first.reducer == second.reducer
+         && first.limit == second.limit
+         && first.element_size == second.element_size
+         && first.element == second.element
+         && first.order == second.order
+         && first.input == second.input;
+}
@@ -0,0 +1,61 @@
+#ifndef MERGE_PLAN_H_
+#define MERGE_PLAN_H_
+
+#include <string>
+#include <vector>
+
+// Costs of accessing storage device
+struct DeviceProfile {
+  // Average time of random access in seconds
+  double seek_time;
+  // Sequential transfer speed in bytes per second
+  double bandwidth;
+};
+
+// Size of buffers for merging fan_in runs at once, if memory elements
+// may be buffered, each run needs buffers_per_run buffers and run_overhead
+// elements besides them, and one more buffer is taken by output
+size_t MergeBuffer(size_t memory, size_t fan_in, size_t buffers_per_run, size_t run_overhead);
+
+// Choose number of runs merged at once which minimizes estimated time
+// of merging runs_num runs of count elements of element_size bytes in total
+// with buffers given by MergeBuffer
+size_t PlanFanIn(size_t runs_num, size_t count, size_t element_size, size_t memory,
+                 size_t buffers_per_run, size_t run_overhead, DeviceProfile device);
+
+// Progress of merge saved between passes
+struct MergeState {
+  // Total number of elements being sorted
+  size_t count;
+  // Whether runs are compressed
+  bool compressed;
+  // Name of reducer folding runs
+  std::string reducer;
+  // Number of smallest elements runs were cut to; zero if none
+  size_t limit;
+  // Size and name of element type and name of order; names are
+  // only compared, so any stable ones fit
+  size_t element_size;
+  std::string element;
+  std::string order;
+  // Stamp of input file, telling if it was replaced or changed
+  std::string input;
+  // Index of temporary file holding runs
+  int temp;
+  // Lengths of runs and their byte offsets in temporary file; folded runs
+  // are shorter than space reserved for them, so offsets are kept too
+  std::vector<size_t> runs;
+  std::vector<size_t> offsets;
+};
+
+// Read state saved to path; returns false if there is none
+bool LoadMergeState(const std::string &path, MergeState *state);
+
+// Atomically replace state saved to path
+void SaveMergeState(const std::string &path, const MergeState &state);
+
+// Check if states belong to the same sort: of the same input with
+// the same options, so that runs of one are valid for the other
+bool SameSort(const MergeState &first, const MergeState &second);
+
+#endif // MERGE_PLAN_H_
@@ -0,0 +1,141 @@
+#ifndef RADIX_SORT_H_
+#define RADIX_SORT_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+// Unsigned integer of given size in bytes
+template <size_t size> struct UnsignedOf;
+template <> struct UnsignedOf<1> { using type = uint8_t; };
+template <> struct UnsignedOf<2> { using type = uint16_t; };
+template <> struct UnsignedOf<4> { using type = uint32_t; };
+template <> struct UnsignedOf<8> { using type = uint64_t; };
+
+// Radix sort is used for integers and IEEE floats of up to 8 bytes
+template <typename T>
+struct RadixSortable : std::integral_constant<bool,
+    (std::is_integral<T>::value
+     || (std::is_floating_point<T>::value && std::numeric_limits<T>::is_iec559))
+    && sizeof(T) <= 8 && (sizeof(T) & (sizeof(T) - 1)) == 0> {};
+
+// Map element to unsigned integer with the same order
+template <typename T>
+typename UnsignedOf<sizeof(T)>::type RadixKey(T element) {
+  using Key = typename UnsignedOf<sizeof(T)>::type;
+  const Key kSignBit = Key(1) << (8 * sizeof(T) - 1);
+
+  Key key;
+  std::memcpy(&key, &element, sizeof(T));
+
+  if (std::is_floating_point<T>::value) {
+    // Negative floats are ordered backwards by their bits
+    return key & kSignBit ? Key(~key) : Key(key | kSignBit);
+  } else if (std::is_signed<T>::value) {
+    return key ^ kSignBit;
+  }
+  return key;
+}
+
+// Buckets smaller than this are sorted by comparison
+const size_t kRadixSortCutoff = 64;
+
+// In-place most significant digit first radix sort (American flag sort)
+// by byte of key starting at bit shift
+template <typename T>
+void RadixSort(T *first, T *last, int shift) {
+  const size_t kBuckets = 256;
+
+  while (size_t(last - first) >= kRadixSortCutoff) {
+    auto digit = [shift](T element) {
+      return size_t(RadixKey(element) >> shift) & (kBuckets - 1);
+    };
+
+    // Count in four histograms, so that increments of equal neighbours
+    // do not wait for each other
+    size_t counts[4][kBuckets] = {};
+    T *it = first;
+    for (; last - it >= 4; it += 4) {
+      ++counts[0][digit(it[0])];
+      ++counts[1][digit(it[1])];
+      ++counts[2][digit(it[2])];
+      ++counts[3][digit(it[3])];
+    }
+    for (; it != last; ++it)
+      ++counts[0][digit(*it)];
+
+    size_t heads[kBuckets];
+    size_t tails[kBuckets];
+    size_t offset = 0;
+    size_t used_buckets = 0;
+    for (size_t bucket = 0; bucket < kBuckets; ++bucket) {
+      const size_t count = counts[0][bucket] + counts[1][bucket]
+                           + counts[2][bucket] + counts[3][bucket];
+      used_buckets += count != 0;
+      heads[bucket] = offset;
+      offset += count;
+      tails[bucket] = offset;
+    }
+
+    if (shift == 0) {
+      // Elements of one bucket have equal keys at the last digit,
+      // so buckets are just filled instead of permuting elements
+      T values[kBuckets];
+      for (T *element = first; element != last; ++element)
+        values[digit(*element)] = *element;
+      for (size_t bucket = 0; bucket < kBuckets; ++bucket)
+        std::fill(first + heads[bucket], first + tails[bucket], values[bucket]);
+      return;
+    }
+
+    // Everything is in one bucket; just go to the next digit
+    if (used_buckets > 1) {
+      for (size_t bucket = 0; bucket < kBuckets; ++bucket) {
+        while (heads[bucket] < tails[bucket]) {
+          T element = first[heads[bucket]];
+          size_t target = digit(element);
+          while (target != bucket) {
+            std::swap(element, first[heads[target]++]);
+            target = digit(element);
+          }
+          first[heads[bucket]++] = element;
+        }
+      }
+    }
+
+    shift -= 8;
+
+    if (used_buckets > 1) {
+      size_t begin = 0;
+      for (size_t bucket = 0; bucket < kBuckets; ++bucket) {
+        RadixSort(first + begin, first + tails[bucket], shift);
+        begin = tails[bucket];
+      }
+      return;
+    }
+  }
+
+  std::sort(first, last);
+}
+
+template <typename T>
+void SortNatural(T *first, T *last, std::true_type) {
+  RadixSort(first, last, 8 * (sizeof(T) - 1));
+}
+
+template <typename T>
+void SortNatural(T *first, T *last, std::false_type) {
+  std::sort(first, last);
+}
+
+// Sort elements with radix sort if they are integers or floats,
+// with std::sort otherwise
+template <typename T>
+void SortElements(T *first, T *last) {
+  SortNatural(first, last, RadixSortable<T>());
+}
+
+#endif // RADIX_SORT_H_
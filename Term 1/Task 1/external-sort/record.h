@@ -0,0 +1,129 @@
+#ifndef RECORD_H_
+#define RECORD_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "radix_sort.h"
+
+// Fixed-width binary record
+template <size_t size>
+struct Record {
+  unsigned char bytes[size];
+};
+
+// Orders records by key_size bytes starting from key_offset,
+// compared as unsigned big-endian numbers
+// Besides comparison, policies may provide Prefix: unsigned number such that
+// Prefix(a) < Prefix(b) implies a < b; then elements are sorted by prefixes
+// and indices instead of being moved around during sort
+template <size_t size, size_t key_offset, size_t key_size>
+struct RecordKeyLess {
+  static_assert(key_offset + key_size <= size, "Key has to be inside of record");
+
+  bool operator()(const Record<size> &a, const Record<size> &b) const {
+    return std::memcmp(a.bytes + key_offset, b.bytes + key_offset, key_size) < 0;
+  }
+
+  // First 8 bytes of key as a number
+  uint64_t Prefix(const Record<size> &record) const {
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 8; ++i)
+      prefix = (prefix << 8) | (i < key_size ? record.bytes[key_offset + i] : 0);
+
+    return prefix;
+  }
+};
+
+// Records handled by command line tools: 16-byte key and 48-byte payload
+using KeyedRecord = Record<64>;
+using KeyedRecordLess = RecordKeyLess<64, 0, 16>;
+
+// Check if Compare policy provides Prefix for T
+template <typename Compare, typename T>
+class HasPrefix {
+  template <typename C>
+  static auto Test(int) -> decltype(std::declval<const C &>().Prefix(std::declval<const T &>()),
+                                    std::true_type());
+
+  template <typename C>
+  static std::false_type Test(...);
+
+ public:
+  static const bool value = decltype(Test<Compare>(0))::value;
+};
+
+// Pair of key prefix and index of element sorted by SortByPrefix
+using PrefixEntry = std::pair<uint64_t, size_t>;
+
+// Sort pairs of key prefixes and indices, then move every element once
+// to its place following cycles of permutation
+template <typename T, typename Compare>
+void SortByPrefix(T *first, T *last, Compare compare) {
+  using Entry = PrefixEntry;
+
+  const size_t count = last - first;
+  std::vector<Entry> entries(count);
+  for (size_t i = 0; i < count; ++i)
+    entries[i] = Entry(compare.Prefix(first[i]), i);
+
+  std::sort(entries.begin(), entries.end(), [first, &compare](const Entry &a, const Entry &b) {
+    if (a.first != b.first)
+      return a.first < b.first;
+    return compare(first[a.second], first[b.second]);
+  });
+
+  // entries[i].second is index of element which has to be placed at i
+  for (size_t i = 0; i < count; ++i) {
+    if (entries[i].second == i)
+      continue;
+
+    T element = first[i];
+    size_t hole = i;
+    while (entries[hole].second != i) {
+      const size_t next = entries[hole].second;
+      first[hole] = first[next];
+      entries[hole].second = hole;
+      hole = next;
+    }
+    first[hole] = element;
+    entries[hole].second = hole;
+  }
+}
+
+template <typename T, typename Compare>
+void SortElements(T *first, T *last, Compare compare, std::true_type) {
+  SortByPrefix(first, last, compare);
+}
+
+template <typename T, typename Compare>
+void SortElements(T *first, T *last, Compare compare, std::false_type) {
+  std::sort(first, last, compare);
+}
+
+// Sort elements by prefixes if policy provides them,
+// with comparisons otherwise
+template <typename T, typename Compare>
+void SortElements(T *first, T *last, Compare compare) {
+  SortElements(first, last, compare, std::integral_constant<bool, HasPrefix<Compare, T>::value>());
+}
+
+// Bytes SortElements allocates per element besides elements themselves:
+// entries of elements sorted by prefixes; other sorts work in place
+template <typename T, typename Compare>
+struct SortOverhead
+  : std::integral_constant<size_t, HasPrefix<Compare, T>::value ? sizeof(PrefixEntry) : 0> {};
+
+// Natural order of integers and floats is sorted with radix sort
+template <typename T>
+void SortElements(T *first, T *last, std::less<T>) {
+  SortElements(first, last);
+}
+
+#endif // RECORD_H_
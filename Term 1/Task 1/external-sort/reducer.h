@@ -0,0 +1,133 @@
+#ifndef REDUCER_H_
+#define REDUCER_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include "record.h"
+
+// Reducers fold every series of equal elements of sorted output into one
+// element. Series are folded as early as possible: in sorted runs,
+// and then again after every merge. Reducer provides:
+//   kEnabled: false if elements are kept as they are;
+//   Name(): name of reducer telling saved runs of different sorts apart;
+//   Init(T *element): prepare element read from input;
+//   Combine(T *result, const T &element): fold element equal to result into it.
+
+// Keeps every element
+struct NoReducer {
+  static const bool kEnabled = false;
+
+  static const char *Name() {
+    return "none";
+  }
+
+  template <typename T>
+  void Init(T *) const {}
+
+  template <typename T>
+  void Combine(T *, const T &) const {}
+};
+
+// Keeps first of equal elements
+struct UniqueReducer {
+  static const bool kEnabled = true;
+
+  static const char *Name() {
+    return "unique";
+  }
+
+  template <typename T>
+  void Init(T *) const {}
+
+  template <typename T>
+  void Combine(T *, const T &) const {}
+};
+
+// Unsigned 8-byte value placed in record at value_offset in host byte order
+template <size_t size, size_t value_offset>
+struct RecordValue {
+  static_assert(value_offset + sizeof(uint64_t) <= size, "Value has to be inside of record");
+
+  static uint64_t Load(const Record<size> &record) {
+    uint64_t value;
+    std::memcpy(&value, record.bytes + value_offset, sizeof(value));
+    return value;
+  }
+
+  static void Store(Record<size> *record, uint64_t value) {
+    std::memcpy(record->bytes + value_offset, &value, sizeof(value));
+  }
+};
+
+// Replaces values of records with number of records having the same key
+template <size_t size, size_t value_offset>
+struct CountReducer : RecordValue<size, value_offset> {
+  using Value = RecordValue<size, value_offset>;
+
+  static const bool kEnabled = true;
+
+  static const char *Name() {
+    return "count";
+  }
+
+  void Init(Record<size> *record) const {
+    Value::Store(record, 1);
+  }
+
+  void Combine(Record<size> *result, const Record<size> &record) const {
+    Value::Store(result, Value::Load(*result) + Value::Load(record));
+  }
+};
+
+// Sums values of records having the same key
+template <size_t size, size_t value_offset>
+struct SumReducer : RecordValue<size, value_offset> {
+  using Value = RecordValue<size, value_offset>;
+
+  static const bool kEnabled = true;
+
+  static const char *Name() {
+    return "sum";
+  }
+
+  void Init(Record<size> *) const {}
+
+  void Combine(Record<size> *result, const Record<size> &record) const {
+    Value::Store(result, Value::Load(*result) + Value::Load(record));
+  }
+};
+
+// Value of KeyedRecord follows its key
+using KeyedRecordCount = CountReducer<64, 16>;
+using KeyedRecordSum = SumReducer<64, 16>;
+
+// Prepare elements read from input for reducer
+template <typename T, typename Reducer>
+void InitElements(T *first, T *last, const Reducer &reducer) {
+  if (!Reducer::kEnabled)
+    return;
+
+  for (T *element = first; element != last; ++element)
+    reducer.Init(element);
+}
+
+// Fold series of equal neighbours of sorted elements in place;
+// returns end of folded elements
+template <typename T, typename Compare, typename Reducer>
+T *Reduce(T *first, T *last, Compare compare, const Reducer &reducer) {
+  if (!Reducer::kEnabled || first == last)
+    return last;
+
+  T *result = first;
+  for (T *element = first + 1; element != last; ++element) {
+    if (compare(*result, *element))
+      *++result = *element;
+    else
+      reducer.Combine(result, *element);
+  }
+
+  return result + 1;
+}
+
+#endif // REDUCER_H_
@@ -0,0 +1,129 @@
+#ifndef REPLACEMENT_SELECTION_H_
+#define REPLACEMENT_SELECTION_H_
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "file_mapper.h"
+#include "reducer.h"
+#include "run_format.h"
+
+// Sort runs of file into temp with replacement selection: elements stream
+// through a heap of about memory elements, and each read element joins
+// the current run if it is not less than the last written one.
+// Runs are twice as long as memory on average, and presorted input
+// gives a single run; equal elements are folded with reducer as they
+// are written, and only first limit elements of every run are kept.
+// Returns lengths of runs placed one after another
+template <typename T, typename Compare, typename Reducer>
+std::vector<size_t> replacement_selection(FileMapper<T> *file, FileMapper<T> *temp,
+                                          size_t memory, bool compressed, Compare compare,
+                                          Reducer reducer, size_t limit) {
+  // Heap puts the least element on top
+  auto greater = [&compare](const T &a, const T &b) { return compare(b, a); };
+
+  // Small part of memory is used for reading and writing buffers
+  const size_t buffer_size = std::max<size_t>(memory / 64, 1);
+  const size_t capacity = std::max<size_t>(memory - std::min(memory, 2 * buffer_size), 1);
+
+  // Compressed runs take unknown space, so mapped temp grows as they are written
+  const size_t total_count = file->Count();
+  if (temp->Mapped() && !compressed)
+    temp->Resize(total_count);
+
+  T *input = new T[buffer_size];
+  size_t read = 0;
+  T *input_position = input;
+  T *input_end = input;
+
+  // One more place for element held back while equal ones may follow it
+  T *output = new T[buffer_size + 1];
+  T *output_position = output;
+  size_t run_offset = 0;
+  std::unique_ptr<RunWriter<T>> writer;
+
+  auto next = [&](T *element) -> bool {
+    if (input_position == input_end) {
+      const size_t fetched = file->Read(input, buffer_size, read);
+      read += fetched;
+      input_position = input;
+      input_end = input + fetched;
+      if (!fetched)
+        return false;
+    }
+    *element = *input_position++;
+    reducer.Init(element);
+    return true;
+  };
+
+  // Last element of run is written only when the whole run is
+  auto flush = [&](bool whole_run) {
+    const size_t held = Reducer::kEnabled && !whole_run && output_position != output ? 1 : 0;
+    writer->Write(output, output_position - output - held);
+    if (held)
+      output[0] = output_position[-1];
+    output_position = output + held;
+  };
+
+  // Heap of current run takes [0, heap_size); elements of next run
+  // are gathered in [heap_size, size) as current heap shrinks
+  T *heap = new T[capacity];
+  size_t size = 0;
+  while (size < capacity && next(heap + size))
+    ++size;
+  size_t heap_size = 0;
+
+  std::vector<size_t> runs;
+  while (size) {
+    if (!heap_size) {
+      heap_size = size;
+      std::make_heap(heap, heap + heap_size, greater);
+
+      if (writer) {
+        flush(true);
+        writer->Close();
+        run_offset += RunExtent<T>(runs.back(), compressed);
+      }
+      writer.reset(new RunWriter<T>(temp, run_offset, compressed));
+      runs.push_back(0);
+    }
+
+    std::pop_heap(heap, heap + heap_size, greater);
+    T *free = heap + heap_size - 1;
+
+    const T last = *free;
+    if (Reducer::kEnabled && output_position != output && !compare(output_position[-1], last)) {
+      reducer.Combine(output_position - 1, last);
+    } else if (runs.back() < limit) {
+      *output_position++ = last;
+      ++runs.back();
+      if (output_position >= output + buffer_size)
+        flush(false);
+    }
+
+    if (next(free)) {
+      if (compare(*free, last))
+        --heap_size;
+      else
+        std::push_heap(heap, heap + heap_size, greater);
+    } else {
+      *free = heap[size - 1];
+      --heap_size;
+      --size;
+    }
+  }
+  if (writer) {
+    flush(true);
+    writer->Close();
+  }
+
+  delete[] heap;
+  delete[] output;
+  delete[] input;
+
+  return runs;
+}
+
+#endif // REPLACEMENT_SELECTION_H_
@@ -0,0 +1,199 @@
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "external_sort.h"
+#include "file_mapper.h"
+#include "merge_plan.h"
+#include "reducer.h"
+
+namespace {
+
+const char kInput[] = "resume_test.input";
+const char kTemp[] = "resume_test.temp";
+const char kSpare[] = "resume_test.spare";
+const char kOutput[] = "resume_test.output";
+const char kState[] = "resume_test.state";
+
+const size_t kCount = 10000;
+const size_t kMemory = 256;
+
+// Elements with many duplicates, so that reducers fold something
+std::vector<int64_t> MakeInput() {
+  std::mt19937 random(1);
+  std::vector<int64_t> elements(kCount);
+  for (auto &element : elements)
+    element = random() % (kCount / 4);
+
+  FileMapper<int64_t> input(kInput, std::ios::trunc);
+  input.Write(elements.data(), elements.size(), 0);
+
+  return elements;
+}
+
+SortOptions MakeOptions() {
+  SortOptions options;
+  options.memory = kMemory;
+  options.workers = 1;
+  options.replacement_selection = false;
+  options.compressed = false;
+  options.io_threads = 0;
+  options.device = DeviceProfile{0.01, 1e8};
+  options.state = kState;
+  options.limit = 0;
+
+  return options;
+}
+
+// Leave runs and state as if sort with given options was interrupted
+// right after runs were generated
+template <typename Reducer>
+void Interrupt(const SortOptions &options) {
+  FileMapper<int64_t> input(kInput);
+  FileMapper<int64_t> temp(kTemp, std::ios::trunc);
+
+  MergeState state = new_merge_state<int64_t, std::less<int64_t>, Reducer>(&input, options);
+  state.runs = generate_runs(&input, &temp, options, std::less<int64_t>(), Reducer(),
+                             &state.offsets);
+  SaveMergeState(options.state, state);
+}
+
+// Sort input with options, resuming from saved state if it fits them
+template <typename Reducer>
+std::vector<int64_t> Resume(const SortOptions &options) {
+  FileMapper<int64_t> input(kInput);
+  FileMapper<int64_t> temp(kTemp);
+  FileMapper<int64_t> spare(kSpare, std::ios::trunc);
+  FileMapper<int64_t> output(kOutput, std::ios::trunc);
+
+  external_sort(&input, &temp, &spare, &output, options, std::less<int64_t>(), Reducer());
+
+  std::vector<int64_t> result(output.Count());
+  output.Read(result.data(), result.size(), 0);
+
+  return result;
+}
+
+// Runs folded by another reducer must not be merged
+void TestReducerChanged(const std::vector<int64_t> &elements) {
+  SortOptions options = MakeOptions();
+  Interrupt<UniqueReducer>(options);
+
+  std::vector<int64_t> expected(elements);
+  std::sort(expected.begin(), expected.end());
+
+  const std::vector<int64_t> result = Resume<NoReducer>(options);
+  assert(result == expected);
+  assert(!std::ifstream(kState).good());
+}
+
+// Runs of int64 are not merged as doubles of the same file;
+// negative doubles are ordered backwards when read as int64
+void TestTypeChanged() {
+  std::mt19937 random(2);
+  std::vector<double> expected(kCount);
+  for (auto &element : expected)
+    element = static_cast<double>(random() % kCount) - kCount / 2;
+  {
+    FileMapper<double> input(kInput, std::ios::trunc);
+    input.Write(expected.data(), expected.size(), 0);
+  }
+  std::sort(expected.begin(), expected.end());
+
+  SortOptions options = MakeOptions();
+  Interrupt<NoReducer>(options);
+
+  FileMapper<double> input(kInput);
+  FileMapper<double> temp(kTemp);
+  FileMapper<double> spare(kSpare, std::ios::trunc);
+  FileMapper<double> output(kOutput, std::ios::trunc);
+  external_sort(&input, &temp, &spare, &output, options);
+
+  std::vector<double> result(output.Count());
+  output.Read(result.data(), result.size(), 0);
+  assert(result == expected);
+}
+
+// Runs of replaced input are not merged
+void TestInputChanged(std::vector<int64_t> *elements) {
+  SortOptions options = MakeOptions();
+  Interrupt<NoReducer>(options);
+
+  std::reverse(elements->begin(), elements->end());
+  for (auto &element : *elements)
+    element += kCount;
+  // Modification time may be as coarse as a clock tick
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  {
+    FileMapper<int64_t> input(kInput, std::ios::trunc);
+    input.Write(elements->data(), elements->size(), 0);
+  }
+
+  std::vector<int64_t> expected(*elements);
+  std::sort(expected.begin(), expected.end());
+
+  const std::vector<int64_t> result = Resume<NoReducer>(options);
+  assert(result == expected);
+}
+
+// Runs cut for smaller -k lack elements of larger result
+void TestLimitChanged(const std::vector<int64_t> &elements) {
+  SortOptions options = MakeOptions();
+  options.limit = kMemory * 2;
+  Interrupt<NoReducer>(options);
+
+  std::vector<int64_t> expected(elements);
+  std::sort(expected.begin(), expected.end());
+
+  options.limit = kMemory * 8;
+  const std::vector<int64_t> smallest = Resume<NoReducer>(options);
+  assert(smallest == std::vector<int64_t>(expected.begin(), expected.begin() + options.limit));
+
+  Interrupt<NoReducer>(options);
+  options.limit = 0;
+  const std::vector<int64_t> result = Resume<NoReducer>(options);
+  assert(result == expected);
+}
+
+// State of the same sort is used
+void TestResumed(const std::vector<int64_t> &elements) {
+  SortOptions options = MakeOptions();
+  Interrupt<UniqueReducer>(options);
+
+  std::vector<int64_t> expected(elements);
+  std::sort(expected.begin(), expected.end());
+  expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+
+  const std::vector<int64_t> result = Resume<UniqueReducer>(options);
+  assert(result == expected);
+
+  options.limit = kMemory * 2;
+  Interrupt<UniqueReducer>(options);
+  expected.resize(options.limit);
+  const std::vector<int64_t> smallest = Resume<UniqueReducer>(options);
+  assert(smallest == expected);
+}
+
+}  // namespace
+
+int main() {
+  std::vector<int64_t> elements = MakeInput();
+
+  TestReducerChanged(elements);
+  TestTypeChanged();
+  TestInputChanged(&elements);
+  TestLimitChanged(elements);
+  TestResumed(elements);
+
+  for (const char *file : {kInput, kTemp, kSpare, kOutput, kState})
+    std::remove(file);
+
+  std::cout << "OK" << std::endl;
+  return 0;
+}
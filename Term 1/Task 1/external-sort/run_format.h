@@ -0,0 +1,452 @@
+#ifndef RUN_FORMAT_H_
+#define RUN_FORMAT_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "file_mapper.h"
+#include "radix_sort.h"
+
+// Runs are placed in temporary file one after another either raw or
+// compressed. Compressed run is a sequence of blocks of up to kRunBlock
+// elements each:
+//   uint32 count, uint8 width, 3 bytes of padding, uint64 first element bits,
+//   then zigzag-encoded differences between bits of neighbour elements
+//   packed into 64-bit words using width bits each.
+// Sorted neighbours are close, so differences are narrow; if they are not,
+// block has width kStoredBlock and keeps the rest of elements as they are.
+// Every run is given range of RunExtent bytes, which is enough for it
+// in any case, so runs may be written independently of each other.
+// Only integers and floats of up to 8 bytes may be compressed.
+
+// Number of elements in compressed block
+const size_t kRunBlock = 4096;
+
+// Size of compressed block header in bytes
+const size_t kRunBlockHeader = 16;
+
+// Width of block holding elements uncompressed
+const uint8_t kStoredBlock = 0xff;
+
+// Size of buffer for compressed data of run writer in bytes
+const size_t kRunWriterBuffer = 1 << 16;
+
+// Get number of bytes reserved in file for run of count elements
+template <typename T>
+size_t RunExtent(size_t count, bool compressed) {
+  if (!compressed)
+    return count * sizeof(T);
+
+  // Header and padding of payload to whole words
+  const size_t block_overhead = kRunBlockHeader + sizeof(uint64_t);
+  return count * sizeof(T) + (count + kRunBlock - 1) / kRunBlock * block_overhead;
+}
+
+template <typename T>
+struct RunCodec {
+  using Bits = typename UnsignedOf<sizeof(T)>::type;
+
+  static uint64_t ToBits(T element) {
+    Bits bits;
+    std::memcpy(&bits, &element, sizeof(T));
+    return bits;
+  }
+
+  static T FromBits(uint64_t bits) {
+    Bits narrow = Bits(bits);
+    T element;
+    std::memcpy(&element, &narrow, sizeof(T));
+    return element;
+  }
+
+  // Largest size of encoded block in bytes
+  static size_t MaxBlockSize() {
+    return kRunBlockHeader + kRunBlock * sizeof(uint64_t);
+  }
+
+  // Encode count elements into out; returns size of block in bytes
+  static size_t Encode(const T *elements, size_t count, char *out) {
+    uint64_t previous = ToBits(elements[0]);
+    uint64_t combined = 0;
+    for (size_t i = 1; i < count; ++i) {
+      const uint64_t bits = ToBits(elements[i]);
+      combined |= ZigZag(bits - previous);
+      previous = bits;
+    }
+
+    uint32_t count32 = count;
+    uint8_t width = 0;
+    while (width < 64 && (combined >> width))
+      ++width;
+    if (PayloadSize(count, width) > PayloadSize(count, kStoredBlock))
+      width = kStoredBlock;
+
+    std::memset(out, 0, kRunBlockHeader);
+    std::memcpy(out, &count32, sizeof(count32));
+    std::memcpy(out + 4, &width, sizeof(width));
+    const uint64_t first = ToBits(elements[0]);
+    std::memcpy(out + 8, &first, sizeof(first));
+
+    char *payload = out + kRunBlockHeader;
+    const size_t payload_size = PayloadSize(count, width);
+    std::memset(payload, 0, payload_size);
+
+    if (width == kStoredBlock) {
+      std::memcpy(payload, elements + 1, (count - 1) * sizeof(T));
+      return kRunBlockHeader + payload_size;
+    }
+
+    uint64_t *packed = (uint64_t *) payload;
+    previous = first;
+    size_t bit = 0;
+    for (size_t i = 1; i < count && width; ++i, bit += width) {
+      const uint64_t bits = ToBits(elements[i]);
+      const uint64_t value = ZigZag(bits - previous);
+      previous = bits;
+
+      packed[bit / 64] |= value << (bit % 64);
+      if (bit % 64 + width > 64)
+        packed[bit / 64 + 1] |= value >> (64 - bit % 64);
+    }
+
+    return kRunBlockHeader + payload_size;
+  }
+
+  // Get number of elements and size in bytes of block with given header
+  static void ParseHeader(const char *header, size_t *count, size_t *size) {
+    uint32_t count32;
+    uint8_t width;
+    std::memcpy(&count32, header, sizeof(count32));
+    std::memcpy(&width, header + 4, sizeof(width));
+
+    *count = count32;
+    *size = kRunBlockHeader + PayloadSize(*count, width);
+  }
+
+  // Decode whole block into out
+  static void Decode(const char *block, T *out) {
+    uint32_t count;
+    uint8_t width;
+    uint64_t previous;
+    std::memcpy(&count, block, sizeof(count));
+    std::memcpy(&width, block + 4, sizeof(width));
+    std::memcpy(&previous, block + 8, sizeof(previous));
+
+    out[0] = FromBits(previous);
+    if (width == kStoredBlock) {
+      std::memcpy(out + 1, block + kRunBlockHeader, (count - 1) * sizeof(T));
+      return;
+    }
+
+    const uint64_t *packed = (const uint64_t *) (block + kRunBlockHeader);
+    const uint64_t mask = width == 64 ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+
+    size_t bit = 0;
+    for (size_t i = 1; i < count; ++i, bit += width) {
+      uint64_t value = 0;
+      if (width) {
+        value = packed[bit / 64] >> (bit % 64);
+        if (bit % 64 + width > 64)
+          value |= packed[bit / 64 + 1] << (64 - bit % 64);
+        value &= mask;
+      }
+
+      previous += UnZigZag(value);
+      out[i] = FromBits(previous);
+    }
+  }
+
+ private:
+  // Size of block data following header, padded to whole words
+  static size_t PayloadSize(size_t count, uint8_t width) {
+    const size_t bits = width == kStoredBlock ? 8 * sizeof(T) : width;
+    return ((count - 1) * bits + 63) / 64 * sizeof(uint64_t);
+  }
+
+  static uint64_t ZigZag(uint64_t difference) {
+    return (difference << 1) ^ (0 - (difference >> 63));
+  }
+
+  static uint64_t UnZigZag(uint64_t value) {
+    return (value >> 1) ^ (0 - (value & 1));
+  }
+};
+
+// Writes run into file starting from byte offset. Compressed run is
+// buffered until Close, which has to be called explicitly, as it
+// reports errors; writer destroyed without it, e.g. by an exception,
+// leaves buffered elements unwritten
+template <typename T>
+class RunWriter {
+ public:
+  RunWriter(FileMapper<T> *file, size_t offset, bool compressed)
+    : file_(file),
+      position_(offset),
+      compressed_(compressed) {
+    if (compressed_) {
+      CheckCompressible(RadixSortable<T>());
+      block_.reserve(kRunBlock);
+      output_.resize(std::max(kRunWriterBuffer, MaxBlockSize()));
+      output_size_ = 0;
+    }
+  }
+
+  RunWriter(const RunWriter &) = delete;
+  RunWriter & operator=(const RunWriter &) = delete;
+
+  // Append count elements to run
+  void Write(const T *elements, size_t count) {
+    if (!compressed_) {
+      file_->WriteBytes(elements, count * sizeof(T), position_);
+      position_ += count * sizeof(T);
+      return;
+    }
+
+    while (count) {
+      // Whole blocks are encoded without gathering
+      if (block_.empty() && count >= kRunBlock) {
+        EncodeBlock(elements, kRunBlock);
+        elements += kRunBlock;
+        count -= kRunBlock;
+        continue;
+      }
+
+      const size_t taken = std::min(count, kRunBlock - block_.size());
+      block_.insert(block_.end(), elements, elements + taken);
+      elements += taken;
+      count -= taken;
+
+      if (block_.size() == kRunBlock) {
+        EncodeBlock(block_.data(), block_.size());
+        block_.clear();
+      }
+    }
+  }
+
+  // Put everything buffered into file
+  void Close() {
+    if (!compressed_)
+      return;
+
+    if (!block_.empty()) {
+      EncodeBlock(block_.data(), block_.size());
+      block_.clear();
+    }
+    FlushOutput();
+  }
+
+ private:
+  static void CheckCompressible(std::true_type) {}
+
+  static void CheckCompressible(std::false_type) {
+    throw std::invalid_argument("runs of this type can not be compressed");
+  }
+
+  static size_t MaxBlockSize() {
+    return MaxBlockSize(RadixSortable<T>());
+  }
+
+  static size_t MaxBlockSize(std::true_type) {
+    return RunCodec<T>::MaxBlockSize();
+  }
+
+  static size_t MaxBlockSize(std::false_type) {
+    return 0;
+  }
+
+  void EncodeBlock(const T *elements, size_t count) {
+    EncodeBlock(elements, count, RadixSortable<T>());
+  }
+
+  void EncodeBlock(const T *elements, size_t count, std::true_type) {
+    if (output_.size() - output_size_ < RunCodec<T>::MaxBlockSize())
+      FlushOutput();
+
+    output_size_ += RunCodec<T>::Encode(elements, count, output_.data() + output_size_);
+  }
+
+  void EncodeBlock(const T *, size_t, std::false_type) {}
+
+  void FlushOutput() {
+    file_->WriteBytes(output_.data(), output_size_, position_);
+    position_ += output_size_;
+    output_size_ = 0;
+  }
+
+  FileMapper<T> *file_;
+  // Byte offset of the next write
+  size_t position_;
+  bool compressed_;
+
+  // Elements of block being gathered and encoded blocks not yet written
+  std::vector<T> block_;
+  std::vector<char> output_;
+  size_t output_size_;
+};
+
+// Reads count elements of run written by RunWriter starting from byte offset;
+// run is read once, so pages of read data are released from page cache
+template <typename T>
+class RunReader {
+ public:
+  RunReader(FileMapper<T> *file, size_t offset, size_t count, bool compressed,
+            size_t buffer_size)
+    : file_(file),
+      position_(offset),
+      end_(offset + RunExtent<T>(count, compressed)),
+      left_(count),
+      compressed_(compressed) {
+    if (compressed_) {
+      CheckCompressible(RadixSortable<T>());
+      input_.resize(std::max(buffer_size * sizeof(T), MaxBlockSize()));
+      input_begin_ = input_end_ = 0;
+    }
+    block_begin_ = block_end_ = 0;
+  }
+
+  RunReader(const RunReader &) = delete;
+  RunReader & operator=(const RunReader &) = delete;
+
+  // Get number of elements reader may allocate besides buffer_size:
+  // block decoded into own buffer and part of compressed block
+  // not fitting into buffer
+  static size_t Overhead(bool compressed) {
+    if (!compressed)
+      return 0;
+    return kRunBlock + (MaxBlockSize() + sizeof(T) - 1) / sizeof(T);
+  }
+
+  // Read next up to count elements of run into out;
+  // returns number of read elements
+  size_t Read(T *out, size_t count) {
+    count = std::min(count, left_);
+
+    if (!compressed_) {
+      const size_t fetched = file_->ReadBytes(out, count * sizeof(T), position_) / sizeof(T);
+      file_->Release(position_, fetched * sizeof(T));
+      position_ += fetched * sizeof(T);
+      left_ -= fetched;
+      return fetched;
+    }
+
+    size_t fetched = 0;
+    while (fetched < count) {
+      if (block_begin_ == block_end_) {
+        // Whole blocks fitting into out are decoded right there
+        const size_t decoded = DecodeBlock(out + fetched, count - fetched);
+        if (!decoded)
+          break;
+        fetched += decoded;
+        continue;
+      }
+
+      const size_t taken = std::min(count - fetched, block_end_ - block_begin_);
+      std::copy(block_.begin() + block_begin_, block_.begin() + block_begin_ + taken, out + fetched);
+      block_begin_ += taken;
+      fetched += taken;
+    }
+    left_ -= fetched;
+
+    return fetched;
+  }
+
+ private:
+  static void CheckCompressible(std::true_type) {}
+
+  static void CheckCompressible(std::false_type) {
+    throw std::invalid_argument("runs of this type can not be compressed");
+  }
+
+  static size_t MaxBlockSize() {
+    return MaxBlockSize(RadixSortable<T>());
+  }
+
+  static size_t MaxBlockSize(std::true_type) {
+    return RunCodec<T>::MaxBlockSize();
+  }
+
+  static size_t MaxBlockSize(std::false_type) {
+    return 0;
+  }
+
+  // Make sure at least size bytes are buffered; returns false at end of run
+  bool Buffer(size_t size) {
+    if (input_end_ - input_begin_ >= size)
+      return true;
+
+    std::memmove(input_.data(), input_.data() + input_begin_, input_end_ - input_begin_);
+    input_end_ -= input_begin_;
+    input_begin_ = 0;
+
+    const size_t wanted = std::min(input_.size() - input_end_, end_ - position_);
+    const size_t fetched = file_->ReadBytes(input_.data() + input_end_, wanted, position_);
+    file_->Release(position_, fetched);
+    position_ += fetched;
+    input_end_ += fetched;
+
+    return input_end_ >= size;
+  }
+
+  // Decode next block into out if it has place for it, or into own buffer
+  // otherwise; returns number of elements put into out
+  size_t DecodeBlock(T *out, size_t place) {
+    return DecodeBlock(out, place, RadixSortable<T>());
+  }
+
+  size_t DecodeBlock(T *out, size_t place, std::true_type) {
+    if (!left_ || !Buffer(kRunBlockHeader))
+      return 0;
+
+    size_t count;
+    size_t size;
+    RunCodec<T>::ParseHeader(input_.data() + input_begin_, &count, &size);
+    if (!Buffer(size))
+      throw std::runtime_error("compressed run is corrupted");
+
+    const char *block = input_.data() + input_begin_;
+    input_begin_ += size;
+    if (count <= place) {
+      RunCodec<T>::Decode(block, out);
+      return count;
+    }
+
+    if (block_.empty())
+      block_.resize(kRunBlock);
+    RunCodec<T>::Decode(block, block_.data());
+    block_begin_ = 0;
+    block_end_ = count;
+
+    const size_t taken = std::min(count, place);
+    std::copy(block_.begin(), block_.begin() + taken, out);
+    block_begin_ = taken;
+
+    return taken;
+  }
+
+  size_t DecodeBlock(T *, size_t, std::false_type) {
+    return 0;
+  }
+
+  FileMapper<T> *file_;
+  // Byte offset of the next read and end of range occupied by run
+  size_t position_;
+  size_t end_;
+  // Number of elements not yet returned
+  size_t left_;
+  bool compressed_;
+
+  // Compressed data read from file and elements of decoded block
+  std::vector<char> input_;
+  size_t input_begin_;
+  size_t input_end_;
+  std::vector<T> block_;
+  size_t block_begin_;
+  size_t block_end_;
+};
+
+#endif // RUN_FORMAT_H_
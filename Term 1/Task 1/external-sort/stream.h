@@ -0,0 +1,72 @@
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <type_traits>
+
+// Reads elements one after another from descriptor, which may be a pipe
+// and so is read only once; descriptor is not closed
+template <typename T>
+class StreamReader {
+  static_assert(std::is_trivially_copyable<T>::value, "Trivially copyable types are supported");
+
+ public:
+  explicit StreamReader(int fd) : fd_(fd) {}
+
+  // Read next up to count elements into out; fewer elements are read
+  // only at end of stream
+  size_t Read(T *out, size_t count) {
+    char *buffer = (char *) out;
+    const size_t size = count * sizeof(T);
+    size_t done = 0;
+    while (done < size) {
+      ssize_t fetched = ::read(fd_, buffer + done, size - done);
+      if (fetched < 0 && errno == EINTR)
+        continue;
+      if (fetched < 0)
+        throw std::runtime_error("read failed");
+      if (fetched == 0)
+        break;
+      done += fetched;
+    }
+
+    if (done % sizeof(T))
+      throw std::invalid_argument("stream is corrupted");
+    return done / sizeof(T);
+  }
+
+ private:
+  int fd_;
+};
+
+// Writes elements one after another to descriptor, which may be a pipe;
+// descriptor is not closed
+template <typename T>
+class StreamWriter {
+  static_assert(std::is_trivially_copyable<T>::value, "Trivially copyable types are supported");
+
+ public:
+  explicit StreamWriter(int fd) : fd_(fd) {}
+
+  void Write(const T *elements, size_t count) {
+    const char *buffer = (const char *) elements;
+    const size_t size = count * sizeof(T);
+    size_t done = 0;
+    while (done < size) {
+      ssize_t written = ::write(fd_, buffer + done, size - done);
+      if (written < 0 && errno == EINTR)
+        continue;
+      if (written < 0)
+        throw std::runtime_error("write failed");
+      done += written;
+    }
+  }
+
+ private:
+  int fd_;
+};
+
+#endif // STREAM_H_
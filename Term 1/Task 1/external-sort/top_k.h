@@ -0,0 +1,141 @@
+#ifndef TOP_K_H_
+#define TOP_K_H_
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "file_mapper.h"
+#include "record.h"
+#include "reducer.h"
+
+// Pass limit smallest elements of input folded by reducer to output
+// in sorted order; returns number of passed elements. Input gives next
+// elements with input(T *out, size_t count) until it returns zero; they
+// stream through buffer of memory elements, which has to hold at least
+// twice as much as limit: when it fills up, only limit smallest elements
+// are kept, and elements not less than the largest of them are discarded
+template <typename T, typename Input, typename Compare, typename Reducer>
+size_t select_smallest(Input input, size_t limit, size_t memory, Compare compare,
+                       Reducer reducer, const std::function<void(const T *, size_t)> &output) {
+  T *buffer = new T[memory];
+  size_t size = 0;
+  T bound;
+  bool bounded = false;
+
+  // Folded series may not be cut, so with reducer elements are sorted
+  // and folded instead of being selected
+  auto shrink = [&]() {
+    if (Reducer::kEnabled) {
+      SortElements(buffer, buffer + size, compare);
+      size = std::min<size_t>(Reduce(buffer, buffer + size, compare, reducer) - buffer, limit);
+    } else if (size > limit) {
+      std::nth_element(buffer, buffer + limit - 1, buffer + size, compare);
+      size = limit;
+      bound = buffer[limit - 1];
+      bounded = true;
+    }
+  };
+
+  while (size_t fetched = input(buffer + size, memory - size)) {
+    T *first = buffer + size;
+    T *last = first + fetched;
+    InitElements(first, last, reducer);
+    if (bounded) {
+      last = std::remove_if(first, last, [&compare, &bound](const T &element) {
+        return !compare(element, bound);
+      });
+    }
+
+    size = last - buffer;
+    if (size == memory)
+      shrink();
+  }
+
+  shrink();
+  SortElements(buffer, buffer + size, compare);
+  output(buffer, size);
+  delete[] buffer;
+
+  return size;
+}
+
+// Tracks bound of limit smallest elements of input while runs are generated:
+// if already sorted runs hold limit elements not greater than bound,
+// elements not less than bound can not get into result.
+// Every run needs at most limit first elements as well.
+// Folded runs may share keys, so they are only cut to limit
+template <typename T, typename Compare>
+class RunCutoff {
+ public:
+  RunCutoff(size_t limit, bool filter, Compare compare)
+    : limit_(limit),
+      filter_(filter),
+      bounded_(false),
+      compare_(compare) {}
+
+  RunCutoff(const RunCutoff &) = delete;
+  RunCutoff & operator=(const RunCutoff &) = delete;
+
+  size_t Limit() const {
+    return limit_;
+  }
+
+  // Remove elements which can not get into result; returns new end
+  T *Filter(T *first, T *last) {
+    T bound;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!filter_ || !bounded_)
+        return last;
+      bound = bound_;
+    }
+
+    Compare compare = compare_;
+    return std::remove_if(first, last, [&compare, &bound](const T &element) {
+      return !compare(element, bound);
+    });
+  }
+
+  // Take into account sorted run which is put into temporary file
+  void AddRun(const T *elements, size_t count) {
+    if (!filter_ || !count)
+      return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Runs are ordered by their last elements, and the least bound is given
+    // by the shortest prefix of them holding limit elements
+    const Run run(elements[count - 1], count);
+    auto less = [this](const Run &a, const Run &b) { return compare_(a.first, b.first); };
+    runs_.insert(std::upper_bound(runs_.begin(), runs_.end(), run, less), run);
+
+    size_t total = 0;
+    for (const auto &prefix_run : runs_) {
+      total += prefix_run.second;
+      if (total >= limit_) {
+        if (!bounded_ || compare_(prefix_run.first, bound_))
+          bound_ = prefix_run.first;
+        bounded_ = true;
+        break;
+      }
+    }
+  }
+
+ private:
+  // Last element and length of sorted run
+  using Run = std::pair<T, size_t>;
+
+  size_t limit_;
+  bool filter_;
+
+  std::mutex mutex_;
+  std::vector<Run> runs_;
+  bool bounded_;
+  T bound_;
+  Compare compare_;
+};
+
+#endif // TOP_K_H_
@@ -6,10 +6,15 @@
 #include <cassert>
 #include <cstring>
 
+#include <algorithm>
 #include <type_traits>
+#include <utility>
 
 const int kArraySpace = 10;
 
+// Runs of this length are sorted by insertion before merging
+const int kInsertionSortLength = 16;
+
 template<typename T>
 class Array {
  public:
@@ -62,16 +67,8 @@ class Array {
     assert(index >= 0);
 
     if (index >= length_) {
-      if (index >= size_) {
-        size_ = index + kArraySpace + 1;
-
-        T *new_array = new T[size_];
-        memcpy(new_array, array_, sizeof(T) * length_);
-        memset(new_array + length_, 0, sizeof(T) * (size_ - length_));
-
-        delete[] array_;
-        array_ = new_array;
-      }
+      if (index >= size_)
+        Grow(index + 1);
 
       length_ = index + 1;
     }
@@ -90,12 +87,60 @@ class Array {
     return length_;
   }
 
+  T *data() {
+    return array_;
+  }
+
+  const T *data() const {
+    return array_;
+  }
+
   T Push(T element) {
     (*this)[this->length()] = element;
 
     return element;
   }
 
+  // Make room for at least size elements without changing length
+  void Reserve(int size) {
+    assert(size >= 0);
+
+    if (size > size_)
+      Reallocate(size);
+  }
+
+  void Append(const T *elements, int count) {
+    assert(count >= 0);
+
+    // Empty source may be null, which memcpy does not allow
+    if (count == 0)
+      return;
+
+    if (length_ + count > size_)
+      Grow(length_ + count);
+
+    memcpy(array_ + length_, elements, sizeof(T) * count);
+    length_ += count;
+  }
+
+  // Take ownership of length elements of buffer allocated with new[]
+  // instead of copying them; former elements are freed unless buffer
+  // is the array's own one, which is kept with new length
+  void Adopt(T *buffer, int length) {
+    assert(buffer != nullptr && length >= 0);
+
+    if (buffer == array_) {
+      assert(length <= size_);
+      length_ = length;
+      return;
+    }
+
+    delete[] array_;
+    array_ = buffer;
+    length_ = length;
+    size_ = length;
+  }
+
   Array<T> Slice(int begin, int end) {
     assert(begin >= 0 && begin < length());
     assert(end >= begin && end < length());
@@ -108,37 +153,83 @@ class Array {
     return slice;
   }
 
+  // Bottom-up merge sort with one buffer: short runs are sorted by
+  // insertion, and then merged pairwise back and forth
   void Sort() {
-    MergeSort(0, length());
+    if (length_ < 2)
+      return;
+
+    for (int begin = 0; begin < length_; begin += kInsertionSortLength)
+      InsertionSort(array_ + begin, array_ + std::min(begin + kInsertionSortLength, length_));
+
+    T *buffer = new T[length_];
+    T *source = array_;
+    T *target = buffer;
+
+    for (int width = kInsertionSortLength; width < length_; width *= 2) {
+      for (int begin = 0; begin < length_; begin += 2 * width) {
+        int middle = std::min(begin + width, length_);
+        int end = std::min(middle + width, length_);
+        Merge(source + begin, source + middle, source + end, target + begin);
+      }
+
+      std::swap(source, target);
+    }
+
+    if (source != array_)
+      memcpy(array_, source, sizeof(T) * length_);
+
+    delete[] buffer;
   }
 
  private:
-  void MergeSort(int begin, int end) {
-    if (begin + 1 == end)
-      return;
+  // Size is at least doubled, so that filling array element by element
+  // takes amortized constant time per element
+  void Grow(int size) {
+    Reallocate(std::max(size + kArraySpace, 2 * size_));
+  }
 
-    int division = begin + (end - begin) / 2;
+  void Reallocate(int size) {
+    T *new_array = new T[size];
+    memcpy(new_array, array_, sizeof(T) * length_);
+    memset(new_array + length_, 0, sizeof(T) * (size - length_));
 
-    MergeSort(begin, division);
-    MergeSort(division, end);
-    
-    Array<T> left_part = Slice(begin, division);
-    int left_end = left_part.length();
+    delete[] array_;
+    array_ = new_array;
+    size_ = size;
+  }
 
-    int left = 0;
-    int right = division;
+  static void InsertionSort(T *begin, T *end) {
+    for (T *current = begin + 1; current < end; ++current) {
+      T element = *current;
 
-    for (int i = begin; left < left_end; ++i) {
-      if (right < end && left_part[left] > (*this)[right]) {
-        (*this)[i] = (*this)[right];
-        ++right;
-      } else {
-        (*this)[i] = left_part[left];
-        ++left;
-      }
+      T *position = current;
+      for (; position != begin && *(position - 1) > element; --position)
+        *position = *(position - 1);
+
+      *position = element;
     }
   }
 
+  // Merge sorted [begin, middle) and [middle, end) into target; equal
+  // elements are taken from the left part first, which keeps sort stable.
+  // Choice of part is turned into pointer increments instead of branch
+  static void Merge(const T *begin, const T *middle, const T *end, T *target) {
+    const T *left = begin;
+    const T *right = middle;
+
+    while (left != middle && right != end) {
+      bool take_right = *left > *right;
+      *target++ = take_right ? *right : *left;
+      right += take_right;
+      left += !take_right;
+    }
+
+    memcpy(target, left, sizeof(T) * (middle - left));
+    target += middle - left;
+    memcpy(target, right, sizeof(T) * (end - right));
+  }
+
   T *array_;
   int length_;
   int size_;
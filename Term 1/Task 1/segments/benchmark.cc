@@ -0,0 +1,75 @@
+// Copyright Alexander Vasilyev
+
+#include <cstdlib>
+#include <ctime>
+
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "array.h"
+
+// Former Array::MergeSort: copies left part into new slice at every level
+template<typename T>
+void RecursiveMergeSort(Array<T> *array, int begin, int end) {
+  if (begin + 1 >= end)
+    return;
+
+  int division = begin + (end - begin) / 2;
+
+  RecursiveMergeSort(array, begin, division);
+  RecursiveMergeSort(array, division, end);
+
+  Array<T> left_part = array->Slice(begin, division);
+  int left_end = left_part.length();
+
+  int left = 0;
+  int right = division;
+
+  for (int i = begin; left < left_end; ++i) {
+    if (right < end && left_part[left] > (*array)[right]) {
+      (*array)[i] = (*array)[right];
+      ++right;
+    } else {
+      (*array)[i] = left_part[left];
+      ++left;
+    }
+  }
+}
+
+double Seconds(clock_t start) {
+  return static_cast<double>(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char **argv) {
+  int length = argc > 1 ? std::stoi(argv[1]) : 1000000;
+
+  std::mt19937_64 generator(0);
+  std::uniform_real_distribution<double> distribution(-1e9, 1e9);
+
+  Array<double> recursive(length);
+  for (int i = 0; i < length; ++i)
+    recursive[i] = distribution(generator);
+  Array<double> bottom_up(recursive);
+
+  clock_t start = clock();
+  RecursiveMergeSort(&recursive, 0, recursive.length());
+  double recursive_time = Seconds(start);
+
+  start = clock();
+  bottom_up.Sort();
+  double bottom_up_time = Seconds(start);
+
+  for (int i = 0; i < length; ++i) {
+    if (recursive.data()[i] != bottom_up.data()[i]) {
+      std::cout << "Sorts differ at " << i << std::endl;
+      return 1;
+    }
+  }
+
+  std::cout << "Sorting " << length << " doubles" << std::endl
+            << "  recursive merge sort: " << recursive_time << "s" << std::endl
+            << "  bottom-up merge sort: " << bottom_up_time << "s" << std::endl;
+
+  return 0;
+}
@@ -1,15 +1,21 @@
 // Copyright Alexander Vasilyev
 
+#include <algorithm>
 #include <iostream>
+#include <string>
+#include <thread>
 
 #include "array.h"
 #include "segments.h"
 
-int main() {
+// With MAX_LEVEL given, lengths covered by exactly 0, 1, ..., MAX_LEVEL
+// segments are printed instead of the single nested length
+int main(int argc, char **argv) {
   Array<EndPoint> end_points;
 
   int segments_num;
   std::cin >> segments_num;
+  end_points.Reserve(2 * segments_num);
 
   for (int i = 0; i < segments_num; ++i) {
     double left, right;
@@ -18,6 +24,17 @@ int main() {
     end_points.Push(EndPoint{right, kRight});
   }
 
+  if (argc > 1) {
+    const int max_level = std::stoi(argv[1]);
+    const int workers = std::max(std::thread::hardware_concurrency(), 1u);
+
+    Array<double> lengths = get_nested_lengths(&end_points, max_level, workers);
+    for (int level = 0; level <= max_level; ++level)
+      std::cout << level << ' ' << lengths[level] << std::endl;
+
+    return 0;
+  }
+
   std::cout << get_nested_1_length(end_points) << std::endl;
 
   return 0;
@@ -1,5 +1,16 @@
 #include "segments.h"
 
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include "array.h"
 
 inline bool operator<(EndPoint a, EndPoint b) {
@@ -18,27 +29,186 @@ inline bool operator>=(EndPoint a, EndPoint b) {
   return a.first >= b.first;
 }
 
-double get_nested_1_length(Array<EndPoint> end_points) {
-  end_points.Sort();
+namespace {
+
+const int kRadixBits = 8;
+const int kRadixSize = 1 << kRadixBits;
+const int kRadixPasses = 64 / kRadixBits;
+
+// Fewer points are not worth a thread
+const int kMinWorkerLength = 1 << 16;
+
+// Unsigned key ordered as double: negative numbers have all bits flipped,
+// so that larger magnitude gives smaller key, and positive ones just
+// get the sign bit set
+inline uint64_t get_radix_key(double value) {
+  const uint64_t kSignBit = uint64_t(1) << 63;
 
-  double result = 0;
-  int nested_level = 0;
-  double matching_point = 0;
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
 
-  for (int i = 0; i < end_points.length(); i++) {
-    EndPoint end_point = end_points[i];
+  return bits & kSignBit ? ~bits : bits | kSignBit;
+}
+
+inline int get_digit(uint64_t key, int pass) {
+  return (key >> (pass * kRadixBits)) & (kRadixSize - 1);
+}
 
-    if (nested_level == 1)
-      result += end_point.first - matching_point;
+int get_workers(int length, int workers) {
+  return std::max(1, std::min(workers, length / kMinWorkerLength));
+}
+
+// Worker gets [begin, end) part of length points
+int get_block_begin(int length, int workers, int worker) {
+  return static_cast<int64_t>(length) * worker / workers;
+}
 
-    if (end_point.second == kLeft)
-      ++nested_level;
-    else
-      --nested_level;
+// Run function(worker) for every worker, current thread being worker 0
+template<typename Function>
+void run_parallel(int workers, Function function) {
+  std::vector<std::thread> threads;
+  for (int worker = 1; worker < workers; ++worker)
+    threads.emplace_back(function, worker);
 
-    if (nested_level == 1)
-      matching_point = end_point.first;
+  function(0);
+
+  for (auto &thread : threads)
+    thread.join();
+}
+
+}  // namespace
+
+void sort_end_points(EndPoint *end_points, int length, int workers) {
+  workers = get_workers(length, workers);
+
+  // counts[(worker * kRadixPasses + pass) * kRadixSize + digit]
+  std::vector<int> counts(workers * kRadixPasses * kRadixSize);
+  auto count = [&](const EndPoint *points, int worker, int first_pass, int last_pass) {
+    int *worker_counts = &counts[worker * kRadixPasses * kRadixSize];
+    for (int pass = first_pass; pass < last_pass; ++pass)
+      std::fill_n(worker_counts + pass * kRadixSize, kRadixSize, 0);
+
+    const int end = get_block_begin(length, workers, worker + 1);
+    for (int i = get_block_begin(length, workers, worker); i < end; ++i) {
+      uint64_t key = get_radix_key(points[i].first);
+      for (int pass = first_pass; pass < last_pass; ++pass)
+        ++worker_counts[pass * kRadixSize + get_digit(key, pass)];
+    }
+  };
+
+  // Digits shared by all points do not change order,
+  // so their passes are skipped
+  run_parallel(workers, [&](int worker) { count(end_points, worker, 0, kRadixPasses); });
+
+  std::vector<int> passes;
+  for (int pass = 0; pass < kRadixPasses; ++pass) {
+    for (int digit = 0; digit < kRadixSize; ++digit) {
+      int total = 0;
+      for (int worker = 0; worker < workers; ++worker)
+        total += counts[(worker * kRadixPasses + pass) * kRadixSize + digit];
+
+      if (total == length)
+        break;
+      if (total != 0) {
+        passes.push_back(pass);
+        break;
+      }
+    }
   }
 
-  return result;
+  std::unique_ptr<EndPoint[]> buffer(new EndPoint[length]);
+  EndPoint *source = end_points;
+  EndPoint *target = buffer.get();
+
+  // Every worker scatters its block after the same digits of previous
+  // blocks, which keeps sort stable
+  std::vector<int> positions(workers * kRadixSize);
+  for (size_t i = 0; i < passes.size(); ++i) {
+    const int pass = passes[i];
+    if (i > 0)
+      run_parallel(workers, [&](int worker) { count(source, worker, pass, pass + 1); });
+
+    int position = 0;
+    for (int digit = 0; digit < kRadixSize; ++digit) {
+      for (int worker = 0; worker < workers; ++worker) {
+        positions[worker * kRadixSize + digit] = position;
+        position += counts[(worker * kRadixPasses + pass) * kRadixSize + digit];
+      }
+    }
+
+    run_parallel(workers, [&](int worker) {
+      int *worker_positions = &positions[worker * kRadixSize];
+      const int end = get_block_begin(length, workers, worker + 1);
+      for (int j = get_block_begin(length, workers, worker); j < end; ++j)
+        target[worker_positions[get_digit(get_radix_key(source[j].first), pass)]++] = source[j];
+    });
+
+    std::swap(source, target);
+  }
+
+  if (source != end_points) {
+    run_parallel(workers, [&](int worker) {
+      const int begin = get_block_begin(length, workers, worker);
+      const int end = get_block_begin(length, workers, worker + 1);
+      memcpy(end_points + begin, source + begin, sizeof(EndPoint) * (end - begin));
+    });
+  }
+}
+
+Array<double> get_nested_lengths(Array<EndPoint> *end_points, int max_level, int workers) {
+  assert(max_level >= 0);
+
+  Array<double> lengths(max_level + 1);
+  const int length = end_points->length();
+  if (length == 0)
+    return lengths;
+
+  EndPoint *points = end_points->data();
+  sort_end_points(points, length, workers);
+  workers = get_workers(length, workers);
+
+  // Nesting level before every block is prefix sum of level changes
+  // in previous blocks
+  std::vector<int> levels(workers + 1, 0);
+  run_parallel(workers, [&](int worker) {
+    int level = 0;
+    const int end = get_block_begin(length, workers, worker + 1);
+    for (int i = get_block_begin(length, workers, worker); i < end; ++i)
+      level += points[i].second == kLeft ? 1 : -1;
+
+    levels[worker + 1] = level;
+  });
+  std::partial_sum(levels.begin(), levels.end(), levels.begin());
+
+  // Gap after every point is covered at the level reached at this point;
+  // levels out of range come only from points sharing coordinate
+  // or from reversed segments
+  std::vector<std::vector<double>> worker_lengths(workers);
+  run_parallel(workers, [&](int worker) {
+    std::vector<double> local(max_level + 1, 0);
+    int level = levels[worker];
+
+    const int end = get_block_begin(length, workers, worker + 1);
+    for (int i = get_block_begin(length, workers, worker); i < end; ++i) {
+      level += points[i].second == kLeft ? 1 : -1;
+
+      if (i + 1 < length && level >= 0 && level <= max_level)
+        local[level] += points[i + 1].first - points[i].first;
+    }
+
+    worker_lengths[worker] = std::move(local);
+  });
+
+  for (int level = 0; level <= max_level; ++level) {
+    for (int worker = 0; worker < workers; ++worker)
+      lengths[level] += worker_lengths[worker][level];
+  }
+
+  return lengths;
+}
+
+double get_nested_1_length(Array<EndPoint> end_points) {
+  const int workers = std::max(std::thread::hardware_concurrency(), 1u);
+
+  return get_nested_lengths(&end_points, 1, workers)[1];
 }
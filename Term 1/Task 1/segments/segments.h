@@ -21,6 +21,14 @@ inline bool operator<=(EndPoint a, EndPoint b);
 inline bool operator>(EndPoint a, EndPoint b);
 inline bool operator>=(EndPoint a, EndPoint b);
 
+// Sort end points by coordinate with radix sort split between workers
+void sort_end_points(EndPoint *end_points, int length, int workers);
+
+// Lengths covered by exactly k segments for every k from 0 to max_level,
+// found in one sweep; level 0 is only counted between the leftmost and
+// the rightmost points. End points are sorted in place
+Array<double> get_nested_lengths(Array<EndPoint> *end_points, int max_level, int workers);
+
 double get_nested_1_length(Array<EndPoint> end_points);
 
 #endif // SEGMENTS_SEGMENTS_H_
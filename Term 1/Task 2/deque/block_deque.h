@@ -0,0 +1,409 @@
+// Copyright Alexander Vasilyev
+
+#ifndef BLOCK_DEQUE_H_
+#define BLOCK_DEQUE_H_
+
+#include <cassert>
+#include <cstddef>
+
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "deque.h"
+
+// Deque stored in fixed-size blocks; only the map of block pointers is
+// reallocated, so push and pop never move elements and references
+// to elements stay valid until they are popped
+template<typename T>
+class BlockDeque {
+ public:
+  // Number of elements in one block
+  static const size_t kBlockSize = sizeof(T) < 64 ? 4096 / sizeof(T) : 64;
+
+  BlockDeque() : size_(0), front_(0), spare_(nullptr) {}
+
+  BlockDeque(const BlockDeque<T> &source) : BlockDeque() {
+    for (size_t i = 0; i < source.Size(); ++i)
+      PushBack(source[i]);
+  }
+
+  BlockDeque(BlockDeque<T> &&source) : BlockDeque() {
+    Swap(source);
+  }
+
+  ~BlockDeque() {
+    Clear();
+    ::operator delete(spare_);
+  }
+
+  BlockDeque<T>& operator=(const BlockDeque<T> &source) {
+    if (&source != this) {
+      BlockDeque<T> copy(source);
+      Swap(copy);
+    }
+
+    return *this;
+  }
+
+  BlockDeque<T>& operator=(BlockDeque<T> &&source) {
+    Swap(source);
+
+    return *this;
+  }
+
+  void Swap(BlockDeque<T> &other) {
+    blocks_.Swap(other.blocks_);
+    std::swap(size_, other.size_);
+    std::swap(front_, other.front_);
+    std::swap(spare_, other.spare_);
+  }
+
+  // Get reference to element by index
+  const T& operator[](size_t index) const {
+    index += front_;
+
+    return blocks_[index / kBlockSize][index % kBlockSize];
+  }
+
+  T & operator[](size_t index) {
+    return const_cast<T &>(static_cast<const BlockDeque<T> *>(this)->operator[](index));
+  }
+
+  // Number of elements in deque
+  size_t Size() const {
+    return size_;
+  }
+
+  // Returns true if there are no elements in deque
+  bool Empty() const {
+    return Size() == 0;
+  }
+
+  // Destroys all elements and frees their blocks
+  void Clear() {
+    while (!Empty())
+      Destroy(&(*this)[--size_]);
+
+    while (!blocks_.Empty())
+      ::operator delete(blocks_.PopBack());
+
+    front_ = 0;
+  }
+
+  // Append element before front
+  template<typename U>
+  void PushFront(U &&element) {
+    const bool new_block = front_ == 0;
+    if (new_block) {
+      AddBlock(true);
+      front_ = kBlockSize;
+    }
+
+    try {
+      new (blocks_.Front() + front_ - 1) T(std::forward<U>(element));
+    } catch (...) {
+      if (new_block) {
+        ReleaseBlock(blocks_.PopFront());
+        front_ = 0;
+      }
+      throw;
+    }
+
+    --front_;
+    ++size_;
+  }
+
+  // Returns front element and erases it
+  T PopFront() {
+    assert(Size() > 0);
+
+    T *place = blocks_.Front() + front_;
+    T element(std::move(*place));
+    Destroy(place);
+
+    ++front_;
+    --size_;
+
+    if (Empty() || front_ == kBlockSize) {
+      ReleaseBlock(blocks_.PopFront());
+      front_ = 0;
+    }
+
+    return element;
+  }
+
+  // Add element after current last element
+  template<typename U>
+  void PushBack(U &&element) {
+    const size_t position = front_ + size_;
+    const bool new_block = position == blocks_.Size() * kBlockSize;
+    if (new_block)
+      AddBlock(false);
+
+    try {
+      new (&blocks_.Back()[position % kBlockSize]) T(std::forward<U>(element));
+    } catch (...) {
+      if (new_block)
+        ReleaseBlock(blocks_.PopBack());
+      throw;
+    }
+
+    ++size_;
+  }
+
+  // Returns last element and erases it
+  T PopBack() {
+    assert(Size() > 0);
+
+    --size_;
+
+    T *place = &(*this)[size_];
+    T element(std::move(*place));
+    Destroy(place);
+
+    if (Empty()) {
+      ReleaseBlock(blocks_.PopBack());
+      front_ = 0;
+    } else if ((front_ + size_) % kBlockSize == 0) {
+      ReleaseBlock(blocks_.PopBack());
+    }
+
+    return element;
+  }
+
+  // Constant reference to first element
+  const T & Front() const {
+    return (*this)[0];
+  }
+
+  // Reference to first element
+  T & Front() {
+    return (*this)[0];
+  }
+
+  // Constant reference to last element
+  const T & Back() const {
+    return (*this)[Size() - 1];
+  }
+
+  // Reference to last element
+  T & Back() {
+    return (*this)[Size() - 1];
+  }
+
+  // Iterator for deque; no range checks are done
+  // Push: invalidates end() and iterators past it, keeps the rest
+  // Pop: invalidates removed element and end()
+  template <bool constant = false>
+  class BlockDequeIterator : public std::iterator<std::random_access_iterator_tag,
+      typename std::conditional<constant, const T, T>::type> {
+    friend BlockDeque<T>;
+    friend BlockDequeIterator<!constant>;
+
+   public:
+    using This = BlockDequeIterator<constant>;
+    using pointer = typename std::conditional<constant, const T *, T *>::type;
+    using reference = typename std::conditional<constant, const T &, T &>::type;
+
+    // Allow conversion from non-constant to constant iterator
+    BlockDequeIterator(const BlockDequeIterator<false> &other)
+        : index_(other.index_),
+          deque_(other.deque_) {}
+
+    reference operator *() const {
+      return (*deque_)[index_];
+    }
+
+    pointer operator ->() const {
+      return &**this;
+    }
+
+    reference operator [](long offset) const {
+      return *(*this + offset);
+    }
+
+    bool operator ==(const This &other) const {
+      return deque_ == other.deque_ && index_ == other.index_;
+    }
+
+    bool operator !=(const This &other) const {
+      return !(*this == other);
+    }
+
+    bool operator <(const This &other) const {
+      return index_ < other.index_;
+    }
+
+    bool operator <=(const This &other) const {
+      return index_ <= other.index_;
+    }
+
+    bool operator >(const This &other) const {
+      return index_ > other.index_;
+    }
+
+    bool operator >=(const This &other) const {
+      return index_ >= other.index_;
+    }
+
+    This & operator +=(long add) {
+      index_ += add;
+      return *this;
+    }
+
+    This operator +(long add) const {
+      This copy(*this);
+      copy += add;
+
+      return copy;
+    }
+
+    This & operator -=(long sub) {
+      return *this += -sub;
+    }
+
+    This operator -(long sub) const {
+      return *this + -sub;
+    }
+
+    This & operator ++() {
+      return *this += 1;
+    }
+
+    This operator ++(int) {
+      This copy(*this);
+      ++*this;
+
+      return copy;
+    }
+
+    This & operator --() {
+      return *this -= 1;
+    }
+
+    This operator --(int) {
+      This copy(*this);
+      --*this;
+
+      return copy;
+    }
+
+    long operator -(const This &other) const {
+      return index_ - other.index_;
+    }
+
+   private:
+    using DequeT = typename std::conditional<constant, const BlockDeque<T>, BlockDeque<T>>::type;
+
+    BlockDequeIterator(DequeT *deque, long index)
+        : index_(index),
+          deque_(deque) {}
+
+    long index_;
+    DequeT *deque_;
+  };
+
+  using Iterator = BlockDequeIterator<false>;
+  using ConstantIterator = BlockDequeIterator<true>;
+  using ReverseIterator = std::reverse_iterator<Iterator>;
+  using ConstantReverseIterator = std::reverse_iterator<ConstantIterator>;
+
+  ConstantIterator cbegin() const {
+    return ConstantIterator(this, 0);
+  }
+
+  Iterator begin() {
+    return Iterator(this, 0);
+  }
+
+  ConstantIterator begin() const {
+    return cbegin();
+  }
+
+  ConstantIterator cend() const {
+    return ConstantIterator(this, Size());
+  }
+
+  Iterator end() {
+    return Iterator(this, Size());
+  }
+
+  ConstantIterator end() const {
+    return cend();
+  }
+
+  ConstantReverseIterator crbegin() const {
+    return ConstantReverseIterator(cend());
+  }
+
+  ReverseIterator rbegin() {
+    return ReverseIterator(end());
+  }
+
+  ConstantReverseIterator rbegin() const {
+    return crbegin();
+  }
+
+  ConstantReverseIterator crend() const {
+    return ConstantReverseIterator(cbegin());
+  }
+
+  ReverseIterator rend() {
+    return ReverseIterator(begin());
+  }
+
+  ConstantReverseIterator rend() const {
+    return crend();
+  }
+
+ private:
+  static void Destroy(T *element) {
+    element->~T();
+  }
+
+  // One released block is kept, so that push and pop alternating
+  // at block border do not allocate every time
+  T *AllocateBlock() {
+    if (spare_) {
+      T *block = spare_;
+      spare_ = nullptr;
+
+      return block;
+    }
+
+    return static_cast<T *>(::operator new(kBlockSize * sizeof(T)));
+  }
+
+  void ReleaseBlock(T *block) {
+    if (spare_)
+      ::operator delete(block);
+    else
+      spare_ = block;
+  }
+
+  // Put new block before or after the others; block is released
+  // if growing the map of blocks throws
+  void AddBlock(bool front) {
+    T *block = AllocateBlock();
+    try {
+      if (front)
+        blocks_.PushFront(block);
+      else
+        blocks_.PushBack(block);
+    } catch (...) {
+      ReleaseBlock(block);
+      throw;
+    }
+  }
+
+  // Blocks hold elements [front_, front_ + size_) of their concatenation;
+  // there are no blocks without elements
+  Deque<T *> blocks_;
+  size_t size_;
+  size_t front_;
+  T *spare_;
+};
+
+#endif  // BLOCK_DEQUE_H_
@@ -6,8 +6,10 @@
 #include <cassert>
 #include <cstring>
 
+#include <algorithm>
 #include <type_traits>
 #include <iterator>
+#include <utility>
 
 // Automatically reallocated data with constant
 // push and pop
@@ -56,11 +58,20 @@ class Deque {
     return *this;
   }
 
+  // Exchange contents with other deque without copying elements
+  void Swap(Deque<T> &other) {
+    std::swap(capacity_, other.capacity_);
+    std::swap(size_, other.size_);
+    std::swap(front_, other.front_);
+    std::swap(back_, other.back_);
+    std::swap(data_, other.data_);
+  }
+
   // Get reference to element by index
   const T& operator[](size_t index) const {
     index += front_;
-    if (index > Size())
-      index -= Size();
+    if (index >= Capacity())
+      index -= Capacity();
 
     return data_[index];
   }
@@ -140,6 +151,68 @@ class Deque {
     return element;
   }
 
+  // Append elements of [first, last) after current last element
+  void PushBackRange(const T *first, const T *last) {
+    const size_t count = last - first;
+    if (!count)
+      return;
+
+    Reserve(Size() + count);
+    CopyIn(back_, first, count);
+
+    back_ = (back_ + count) & (Capacity() - 1);
+    size_ += count;
+  }
+
+  // Insert elements of [first, last) before front keeping their order,
+  // so that *first becomes the front element
+  void PushFrontRange(const T *first, const T *last) {
+    const size_t count = last - first;
+    if (!count)
+      return;
+
+    Reserve(Size() + count);
+
+    front_ = (front_ + Capacity() - count) & (Capacity() - 1);
+    CopyIn(front_, first, count);
+
+    size_ += count;
+  }
+
+  // Moves count front elements to out in deque order and erases them
+  void PopFrontInto(T *out, size_t count) {
+    assert(count <= Size());
+    if (!count)
+      return;
+
+    CopyOut(front_, out, count);
+
+    front_ = (front_ + count) & (Capacity() - 1);
+    size_ -= count;
+
+    ShrinkIfNecessary();
+  }
+
+  // Moves count last elements to out in deque order and erases them
+  void PopBackInto(T *out, size_t count) {
+    assert(count <= Size());
+    if (!count)
+      return;
+
+    back_ = (back_ + Capacity() - count) & (Capacity() - 1);
+    CopyOut(back_, out, count);
+
+    size_ -= count;
+
+    ShrinkIfNecessary();
+  }
+
+  // Allocate place for size elements at once
+  void Reserve(size_t size) {
+    if (size >= Capacity())
+      Realloc(GetMinimalCapacity(size));
+  }
+
   // Constant reference to first element
   const T & Front() const {
     return (*this)[0];
@@ -342,10 +415,29 @@ class Deque {
       Realloc(capacity_ * 2);
   }
 
-  // Shrink to fit memory upper bound
+  // Shrink to fit memory upper bound; bulk pops may need
+  // several quarterings, which are done in one reallocation
   void ShrinkIfNecessary() {
-    if (Size() && Size() * 4 < Capacity())
-      Realloc(capacity_ / 4);
+    size_t capacity = Capacity();
+    while (Size() && Size() * 4 < capacity)
+      capacity /= 4;
+
+    if (capacity != Capacity())
+      Realloc(capacity);
+  }
+
+  // Copy count elements to ring positions from start on; wrapped part
+  // goes to the beginning of data
+  void CopyIn(size_t start, const T *source, size_t count) {
+    const size_t first_part_size = std::min(count, Capacity() - start);
+    std::memcpy(data_ + start, source, first_part_size * sizeof(T));
+    std::memcpy(data_, source + first_part_size, (count - first_part_size) * sizeof(T));
+  }
+
+  void CopyOut(size_t start, T *target, size_t count) const {
+    const size_t first_part_size = std::min(count, Capacity() - start);
+    std::memcpy(target, data_ + start, first_part_size * sizeof(T));
+    std::memcpy(target + first_part_size, data_, (count - first_part_size) * sizeof(T));
   }
 
   // Reallocate deque with new size; locates front and back correctly
@@ -353,7 +445,7 @@ class Deque {
     assert(capacity >= Size());
 
     T *new_data = new T[capacity];
-    if (front_ < back_) {
+    if (front_ + Size() <= Capacity()) {
       std::memcpy(new_data, data_ + front_, Size() * sizeof(T));
     } else {
       const size_t left_part_size = back_;
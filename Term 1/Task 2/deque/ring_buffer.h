@@ -0,0 +1,261 @@
+// Copyright Alexander Vasilyev
+
+#ifndef RING_BUFFER_H_
+#define RING_BUFFER_H_
+
+#include <cassert>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+// Indices touched by different threads are kept on separate lines
+const size_t kCacheLineSize = 64;
+
+enum class RingBufferMode {
+  kSingleProducerSingleConsumer,
+  kMultiProducerMultiConsumer
+};
+
+// Minimal power of 2 not less than desired capacity
+inline size_t GetRingBufferCapacity(size_t desired) {
+  size_t capacity = 2;
+  while (capacity < desired)
+    capacity <<= 1;
+
+  return capacity;
+}
+
+// Fixed-capacity ring buffer for exactly one producer and one consumer
+// thread; every operation is wait-free. Like Deque, it keeps power-of-two
+// capacity, and indices grow freely and are masked on access
+template<typename T>
+class SpscRingBuffer {
+ public:
+  static_assert(std::is_pod<T>::value, "Only PODs are supported");
+
+  explicit SpscRingBuffer(size_t capacity)
+    : capacity_(GetRingBufferCapacity(capacity)),
+      data_(new T[capacity_]) {}
+
+  SpscRingBuffer(const SpscRingBuffer<T> &) = delete;
+  SpscRingBuffer<T>& operator=(const SpscRingBuffer<T> &) = delete;
+
+  size_t Capacity() const {
+    return capacity_;
+  }
+
+  // Producer only; returns false if buffer is full
+  bool TryPush(const T &element) {
+    return TryPushBatch(&element, 1) == 1;
+  }
+
+  // Producer only; pushes as many of count elements as fit
+  // and returns their number
+  size_t TryPushBatch(const T *elements, size_t count) {
+    const size_t back = producer_.back.load(std::memory_order_relaxed);
+    if (back - producer_.front_cache + count > capacity_)
+      producer_.front_cache = consumer_.front.load(std::memory_order_acquire);
+
+    count = std::min(count, capacity_ - (back - producer_.front_cache));
+    if (!count)
+      return 0;
+
+    const size_t start = back & (capacity_ - 1);
+    const size_t first_part_size = std::min(count, capacity_ - start);
+    std::memcpy(data_.get() + start, elements, first_part_size * sizeof(T));
+    std::memcpy(data_.get(), elements + first_part_size, (count - first_part_size) * sizeof(T));
+
+    producer_.back.store(back + count, std::memory_order_release);
+
+    return count;
+  }
+
+  // Consumer only; returns false if buffer is empty
+  bool TryPop(T &element) {
+    return TryPopBatch(&element, 1) == 1;
+  }
+
+  // Consumer only; pops up to count elements into out
+  // and returns their number
+  size_t TryPopBatch(T *out, size_t count) {
+    const size_t front = consumer_.front.load(std::memory_order_relaxed);
+    if (consumer_.back_cache - front < count)
+      consumer_.back_cache = producer_.back.load(std::memory_order_acquire);
+
+    count = std::min(count, consumer_.back_cache - front);
+    if (!count)
+      return 0;
+
+    const size_t start = front & (capacity_ - 1);
+    const size_t first_part_size = std::min(count, capacity_ - start);
+    std::memcpy(out, data_.get() + start, first_part_size * sizeof(T));
+    std::memcpy(out + first_part_size, data_.get(), (count - first_part_size) * sizeof(T));
+
+    consumer_.front.store(front + count, std::memory_order_release);
+
+    return count;
+  }
+
+ private:
+  // Every side keeps last seen index of the other one, so that
+  // it reads the other side's line only when buffer looks full or empty
+  struct alignas(kCacheLineSize) Producer {
+    std::atomic<size_t> back{0};
+    size_t front_cache = 0;
+  };
+
+  struct alignas(kCacheLineSize) Consumer {
+    std::atomic<size_t> front{0};
+    size_t back_cache = 0;
+  };
+
+  const size_t capacity_;
+  std::unique_ptr<T[]> data_;
+  Producer producer_;
+  Consumer consumer_;
+};
+
+// Bounded ring buffer for any number of producers and consumers.
+// Every slot has sequence number telling whose turn it is: slot
+// at position p is free for producer when sequence is p and holds
+// element for consumer when sequence is p + 1
+template<typename T>
+class MpmcRingBuffer {
+ public:
+  static_assert(std::is_pod<T>::value, "Only PODs are supported");
+
+  explicit MpmcRingBuffer(size_t capacity)
+    : capacity_(GetRingBufferCapacity(capacity)),
+      slots_(new Slot[capacity_]) {
+    for (size_t i = 0; i < capacity_; ++i)
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  MpmcRingBuffer(const MpmcRingBuffer<T> &) = delete;
+  MpmcRingBuffer<T>& operator=(const MpmcRingBuffer<T> &) = delete;
+
+  size_t Capacity() const {
+    return capacity_;
+  }
+
+  // Returns false if buffer is full
+  bool TryPush(const T &element) {
+    size_t position = back_.load(std::memory_order_relaxed);
+
+    for (;;) {
+      Slot &slot = slots_[position & (capacity_ - 1)];
+      const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      const long difference = static_cast<long>(sequence - position);
+
+      if (difference == 0) {
+        if (back_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          slot.value = element;
+          slot.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = back_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Returns false if buffer is empty
+  bool TryPop(T &element) {
+    size_t position = front_.load(std::memory_order_relaxed);
+
+    for (;;) {
+      Slot &slot = slots_[position & (capacity_ - 1)];
+      const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      const long difference = static_cast<long>(sequence - (position + 1));
+
+      if (difference == 0) {
+        if (front_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          element = slot.value;
+          slot.sequence.store(position + capacity_, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = front_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Claims up to count consecutive slots with one CAS and fills them;
+  // returns number of pushed elements. A claimed slot may still be
+  // read by consumer that claimed it on previous lap, so it is
+  // waited for
+  size_t TryPushBatch(const T *elements, size_t count) {
+    size_t position = back_.load(std::memory_order_relaxed);
+
+    do {
+      const long used = static_cast<long>(position - front_.load(std::memory_order_acquire));
+      count = std::min(count, capacity_ - std::min<size_t>(std::max(used, 0L), capacity_));
+      if (!count)
+        return 0;
+    } while (!back_.compare_exchange_weak(position, position + count, std::memory_order_relaxed));
+
+    for (size_t i = 0; i < count; ++i) {
+      Slot &slot = slots_[(position + i) & (capacity_ - 1)];
+      while (slot.sequence.load(std::memory_order_acquire) != position + i)
+        std::this_thread::yield();
+
+      slot.value = elements[i];
+      slot.sequence.store(position + i + 1, std::memory_order_release);
+    }
+
+    return count;
+  }
+
+  // Claims up to count consecutive elements with one CAS and moves them
+  // to out; returns their number. Producer may still be writing
+  // a claimed element, so it is waited for
+  size_t TryPopBatch(T *out, size_t count) {
+    size_t position = front_.load(std::memory_order_relaxed);
+
+    do {
+      const long available = static_cast<long>(back_.load(std::memory_order_acquire) - position);
+      count = std::min<size_t>(count, std::max(available, 0L));
+      if (!count)
+        return 0;
+    } while (!front_.compare_exchange_weak(position, position + count, std::memory_order_relaxed));
+
+    for (size_t i = 0; i < count; ++i) {
+      Slot &slot = slots_[(position + i) & (capacity_ - 1)];
+      while (slot.sequence.load(std::memory_order_acquire) != position + i + 1)
+        std::this_thread::yield();
+
+      out[i] = slot.value;
+      slot.sequence.store(position + i + capacity_, std::memory_order_release);
+    }
+
+    return count;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  const size_t capacity_;
+  std::unique_ptr<Slot[]> slots_;
+
+  // Next positions claimed by producers and consumers respectively
+  alignas(kCacheLineSize) std::atomic<size_t> back_{0};
+  alignas(kCacheLineSize) std::atomic<size_t> front_{0};
+};
+
+template<typename T, RingBufferMode mode>
+using RingBuffer = typename std::conditional<
+    mode == RingBufferMode::kSingleProducerSingleConsumer,
+    SpscRingBuffer<T>, MpmcRingBuffer<T>>::type;
+
+#endif  // RING_BUFFER_H_
@@ -0,0 +1,151 @@
+// Copyright Alexander Vasilyev
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ring_buffer.h"
+#include "thread_safe_queue.h"
+
+static const size_t kCapacity = 1024;
+static const size_t kBatchSize = 64;
+
+// Runs producers pushing numbers 1..count split between them and
+// consumers popping all of them; checks that popped sum is right
+// and prints throughput
+template<typename Push, typename Pop>
+void Measure(const std::string &name, int producers, int consumers, size_t count,
+             Push push, Pop pop) {
+  std::vector<std::thread> threads;
+  std::vector<unsigned long long> sums(consumers, 0);
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int producer = 0; producer < producers; ++producer) {
+    threads.emplace_back([=]() {
+      push(count * producer / producers + 1, count * (producer + 1) / producers + 1);
+    });
+  }
+
+  for (int consumer = 0; consumer < consumers; ++consumer) {
+    threads.emplace_back([=, &sums]() {
+      sums[consumer] = pop(count * (consumer + 1) / consumers - count * consumer / consumers);
+    });
+  }
+
+  for (auto &thread : threads)
+    thread.join();
+
+  std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+  unsigned long long sum = 0;
+  for (auto consumer_sum : sums)
+    sum += consumer_sum;
+
+  if (sum != static_cast<unsigned long long>(count) * (count + 1) / 2) {
+    std::cout << name << ": wrong sum" << std::endl;
+    std::exit(1);
+  }
+
+  std::cout << name << " " << producers << "x" << consumers << ": "
+            << count / seconds.count() / 1e6 << " M elements/s" << std::endl;
+}
+
+void MeasureQueue(int producers, int consumers, size_t count) {
+  thread_safe_queue<size_t> queue(kCapacity);
+
+  Measure("thread_safe_queue", producers, consumers, count,
+          [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i)
+              queue.enqueue(i);
+          },
+          [&](size_t count) {
+            unsigned long long sum = 0;
+            for (size_t i = 0; i < count; ++i) {
+              size_t element;
+              queue.pop(element);
+              sum += element;
+            }
+            return sum;
+          });
+}
+
+template<typename Buffer>
+void MeasureRingBuffer(const std::string &name, int producers, int consumers, size_t count) {
+  Buffer buffer(kCapacity);
+
+  Measure(name, producers, consumers, count,
+          [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+              while (!buffer.TryPush(i))
+                std::this_thread::yield();
+            }
+          },
+          [&](size_t count) {
+            unsigned long long sum = 0;
+            size_t element;
+            for (size_t i = 0; i < count; ++i) {
+              while (!buffer.TryPop(element))
+                std::this_thread::yield();
+              sum += element;
+            }
+            return sum;
+          });
+}
+
+template<typename Buffer>
+void MeasureRingBufferBatch(const std::string &name, int producers, int consumers, size_t count) {
+  Buffer buffer(kCapacity);
+
+  Measure(name, producers, consumers, count,
+          [&](size_t first, size_t last) {
+            size_t batch[kBatchSize];
+            while (first < last) {
+              size_t batch_size = std::min(kBatchSize, last - first);
+              for (size_t i = 0; i < batch_size; ++i)
+                batch[i] = first + i;
+
+              size_t pushed = 0;
+              while (pushed < batch_size) {
+                size_t now = buffer.TryPushBatch(batch + pushed, batch_size - pushed);
+                if (!now)
+                  std::this_thread::yield();
+                pushed += now;
+              }
+              first += batch_size;
+            }
+          },
+          [&](size_t count) {
+            unsigned long long sum = 0;
+            size_t batch[kBatchSize];
+            while (count) {
+              size_t popped = buffer.TryPopBatch(batch, std::min(kBatchSize, count));
+              if (!popped)
+                std::this_thread::yield();
+              for (size_t i = 0; i < popped; ++i)
+                sum += batch[i];
+              count -= popped;
+            }
+            return sum;
+          });
+}
+
+int main(int argc, char **argv) {
+  size_t count = argc > 1 ? std::stoul(argv[1]) : 10000000;
+  int threads = argc > 2 ? std::stoi(argv[2]) : 2;
+
+  MeasureQueue(1, 1, count);
+  MeasureRingBuffer<SpscRingBuffer<size_t>>("spsc", 1, 1, count);
+  MeasureRingBufferBatch<SpscRingBuffer<size_t>>("spsc batch", 1, 1, count);
+  MeasureRingBuffer<MpmcRingBuffer<size_t>>("mpmc", 1, 1, count);
+
+  MeasureQueue(threads, threads, count);
+  MeasureRingBuffer<MpmcRingBuffer<size_t>>("mpmc", threads, threads, count);
+  MeasureRingBufferBatch<MpmcRingBuffer<size_t>>("mpmc batch", threads, threads, count);
+
+  return 0;
+}
@@ -2,8 +2,12 @@
 #include <ctime>
 #include <cassert>
 
+#include <algorithm>
+#include <deque>
 #include <iostream>
+#include <string>
 
+#include "block_deque.h"
 #include "deque.h"
 
 static const int kRunCount = 3;
@@ -54,6 +58,135 @@ void test(unsigned long n) {
   }
 }
 
+// Perform n random bulk operations on deque, checking them against std::deque
+void test_range(unsigned long n) {
+  enum class Command { kPushFront, kPopFront, kPushBack, kPopBack, kCommandNum };
+  const int kRange = 2000;
+  const int kMaxCount = 100;
+
+  Deque<int> deque;
+  std::deque<int> expected;
+  int buffer[kMaxCount];
+
+  srand(time(0));
+
+  while (n) {
+    Command command = static_cast<Command>(rand() % static_cast<int>(Command::kCommandNum));
+    size_t count = rand() % kMaxCount;
+
+    switch (command) {
+      case Command::kPushBack:
+        for (size_t i = 0; i < count; ++i)
+          buffer[i] = rand() % kRange;
+        deque.PushBackRange(buffer, buffer + count);
+        expected.insert(expected.end(), buffer, buffer + count);
+        break;
+
+      case Command::kPushFront:
+        for (size_t i = 0; i < count; ++i)
+          buffer[i] = rand() % kRange;
+        deque.PushFrontRange(buffer, buffer + count);
+        expected.insert(expected.begin(), buffer, buffer + count);
+        break;
+
+      case Command::kPopBack:
+        count = std::min(count, deque.Size());
+        deque.PopBackInto(buffer, count);
+        assert(std::equal(buffer, buffer + count, expected.end() - count));
+        expected.erase(expected.end() - count, expected.end());
+        break;
+
+      case Command::kPopFront:
+        count = std::min(count, deque.Size());
+        deque.PopFrontInto(buffer, count);
+        assert(std::equal(buffer, buffer + count, expected.begin()));
+        expected.erase(expected.begin(), expected.begin() + count);
+        break;
+
+      default:
+        continue;
+    }
+
+    assert(deque.Size() == expected.size());
+    --n;
+  }
+
+  for (size_t i = 0; i < expected.size(); ++i)
+    assert(deque[i] == expected[i]);
+}
+
+// Perform n random operations on block deque of strings, checking them
+// against std::deque and checking that references survive pushes
+void test_block(unsigned long n) {
+  enum class Command { kPushFront, kPopFront, kPushBack, kPopBack, kAccess, kCommandNum };
+  const int kRange = 2000;
+
+  BlockDeque<std::string> deque;
+  std::deque<std::string> expected;
+
+  srand(time(0));
+
+  while (n) {
+    Command command = static_cast<Command>(rand() % static_cast<int>(Command::kCommandNum));
+    const std::string *front = deque.Empty() ? nullptr : &deque.Front();
+    const std::string *back = deque.Empty() ? nullptr : &deque.Back();
+
+    switch (command) {
+      case Command::kPushBack: {
+        std::string element = std::to_string(rand() % kRange);
+        expected.push_back(element);
+        deque.PushBack(std::move(element));
+        assert(!front || front == &deque.Front());
+        break;
+      }
+
+      case Command::kPushFront: {
+        std::string element = std::to_string(rand() % kRange);
+        expected.push_front(element);
+        deque.PushFront(element);
+        assert(!back || back == &deque.Back());
+        break;
+      }
+
+      case Command::kPopBack: {
+        if (!deque.Size())
+          continue;
+        std::string element = deque.PopBack();
+        assert(element == expected.back());
+        expected.pop_back();
+        break;
+      }
+
+      case Command::kPopFront: {
+        if (!deque.Size())
+          continue;
+        std::string element = deque.PopFront();
+        assert(element == expected.front());
+        expected.pop_front();
+        break;
+      }
+
+      case Command::kAccess: {
+        if (deque.Size() < 2)
+          continue;
+        size_t index = rand() % deque.Size();
+        assert(deque[index] == expected[index]);
+        deque[index] = expected[index] = std::to_string(rand() % kRange);
+        break;
+      }
+
+      default:
+        continue;
+    }
+
+    assert(deque.Size() == expected.size());
+    --n;
+  }
+
+  BlockDeque<std::string> copy(deque);
+  assert(std::equal(copy.begin(), copy.end(), expected.begin()));
+}
+
 int main() {
   unsigned long n;
 
@@ -68,6 +201,18 @@ int main() {
       time = clock() - time;
       std::cout << "Run #" << i << ": " << ((float) time / n) << "(" << time << " total)" << std::endl;
     }
+    for (int i = 1; i <= kRunCount; ++i) {
+      clock_t time = clock();
+      test_range(n);
+      time = clock() - time;
+      std::cout << "Range run #" << i << ": " << ((float) time / n) << "(" << time << " total)" << std::endl;
+    }
+    for (int i = 1; i <= kRunCount; ++i) {
+      clock_t time = clock();
+      test_block(n);
+      time = clock() - time;
+      std::cout << "Block run #" << i << ": " << ((float) time / n) << "(" << time << " total)" << std::endl;
+    }
   }
 
   return 0;
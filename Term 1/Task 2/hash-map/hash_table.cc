@@ -1,129 +1,204 @@
 #include "hash_table.h"
 
+#include <cstring>
+
 #include <string>
 #include <vector>
-#include <iterator>
 
-const std::string HashTable::kDeleted;
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-HashTable::HashTable() : count_(0), table_(kInitialSize, nullptr) {}
+const int8_t HashTable::kEmpty;
+const int8_t HashTable::kDeleted;
 
-HashTable::~HashTable() {
-  for (auto key : table_) {
-    if (key != &kDeleted)
-      delete key;
-  }
-}
+HashTable::HashTable()
+  : count_(0),
+    deleted_(0),
+    garbage_(0),
+    control_(kInitialSize, kEmpty),
+    slots_(kInitialSize) {}
 
 bool HashTable::Has(const std::string &key) const {
-  for (size_t probe : Probes(table_, key)) {
-    if (table_[probe] == nullptr) {
-      break;
-    } else if (table_[probe] != &kDeleted && *table_[probe] == key) {
-      return true;
-    }
-  }
-
-  return false;
+  return Find(key, Hash(key.data(), key.size())) != Size();
 }
 
 bool HashTable::Add(const std::string &key) {
-  // Rehash if 
-  if (count_ * 4 >= Size() * 3)
-    Grow();
-
-  size_t empty_probe = Size();
-  for (size_t probe : Probes(table_, key)) {
-    if (table_[probe] == nullptr) {
-      if (empty_probe == Size())
-        empty_probe = probe;
-      break;
-    } else if (table_[probe] == &kDeleted) {
-      if (empty_probe == Size())
-        empty_probe = probe;
-    } else if (*table_[probe] == key) {
-      return false;
-    }
-  }
+  const uint64_t hash = Hash(key.data(), key.size());
+  if (Find(key, hash) != Size())
+    return false;
 
-  if (empty_probe != Size()) {
-    table_[empty_probe] = new std::string(key);
-    ++count_;
-    return true;
-  }
+  // Keep at most 7/8 of slots used; if most of used ones are deleted,
+  // cleaning them is enough. Arena is compacted once removed keys
+  // take more than live ones
+  if ((count_ + deleted_ + 1) * 8 > Size() * 7)
+    Rehash(count_ * 2 + 2 > Size() ? Size() * 2 : Size());
+  else if (garbage_ > keys_.size() - garbage_ + kInitialSize * 16)
+    Rehash(Size());
 
-  return false;
+  Insert(key.data(), key.size(), hash);
+
+  return true;
 }
 
 bool HashTable::Remove(const std::string &key) {
-  for (auto probe : Probes(table_, key)) {
-    if (table_[probe] == nullptr) {
-      break;
-    } else if (table_[probe] != &kDeleted && *table_[probe] == key) {
-      delete table_[probe];
-      table_[probe] = &kDeleted;
-      --count_;
-      return true;
-    }
+  const size_t slot = Find(key, Hash(key.data(), key.size()));
+  if (slot == Size())
+    return false;
+
+  // Group with an empty slot was never full, so no probe path goes
+  // past it and slot can become empty instead of deleted
+  const size_t group = slot / kGroupSize;
+  if (Match(group, kEmpty)) {
+    control_[slot] = kEmpty;
+  } else {
+    control_[slot] = kDeleted;
+    ++deleted_;
   }
-  return false;
+
+  garbage_ += slots_[slot].length;
+  --count_;
+
+  return true;
+}
+
+size_t HashTable::Count() const {
+  return count_;
 }
 
 size_t HashTable::Size() const {
-  return table_.size();
+  return control_.size();
 }
 
-void HashTable::Grow() {
-  std::vector<std::string const *> old_table(2 * Size(), nullptr);
-  std::swap(table_, old_table);
-  count_ = 0;
+size_t HashTable::ProbeLength(const std::string &key) const {
+  size_t probes = 0;
+  Find(key, Hash(key.data(), key.size()), &probes);
 
-  for (auto key : old_table)
-    if (key != nullptr && key != &kDeleted) {
-      Add(*key);
-      delete key;
+  return probes;
+}
+
+// Groups are probed with growing steps 1, 2, 3, ..., which visits
+// every group when their number is power of 2
+size_t HashTable::Find(const std::string &key, uint64_t hash, size_t *probes) const {
+  const size_t group_mask = Size() / kGroupSize - 1;
+  const int8_t control = hash & 0x7F;
+
+  size_t group = (hash >> 7) & group_mask;
+  for (size_t step = 1; step <= group_mask + 1; ++step) {
+    if (probes)
+      ++*probes;
+
+    for (uint32_t match = Match(group, control); match; match &= match - 1) {
+      const Slot &slot = slots_[group * kGroupSize + __builtin_ctz(match)];
+      if (slot.hash == hash && slot.length == key.size() &&
+          std::memcmp(keys_.data() + slot.offset, key.data(), key.size()) == 0)
+        return &slot - slots_.data();
     }
+
+    if (Match(group, kEmpty))
+      break;
+
+    group = (group + step) & group_mask;
+  }
+
+  return Size();
 }
 
-HashTable::Probes::Probes(const std::vector<std::string const *> &table, const std::string &key)
-  : table_(table),
-    hash1_(Hash(key)),
-    hash2_((2 * hash1_ + 1) % table_.size()) {}
+size_t HashTable::FindFree(uint64_t hash) const {
+  const size_t group_mask = Size() / kGroupSize - 1;
 
-size_t HashTable::Probes::Hash(const std::string &key) const {
-  size_t hash = 0;
+  size_t group = (hash >> 7) & group_mask;
+  for (size_t step = 1; ; ++step) {
+    uint32_t free = Match(group, kEmpty) | Match(group, kDeleted);
+    if (free)
+      return group * kGroupSize + __builtin_ctz(free);
 
-  for (auto symbol : key)
-    hash = (hash * kHashParameter + symbol) % table_.size();
+    group = (group + step) & group_mask;
+  }
+}
 
-  return hash;
+void HashTable::Insert(const char *key, size_t length, uint64_t hash) {
+  const size_t slot = FindFree(hash);
+  if (control_[slot] == kDeleted)
+    --deleted_;
+
+  control_[slot] = hash & 0x7F;
+  slots_[slot] = Slot{keys_.size(), length, hash};
+  keys_.append(key, length);
+  ++count_;
 }
 
-HashTable::Probes::iterator HashTable::Probes::begin() {
-  return iterator(*this, 0);
+void HashTable::Rehash(size_t size) {
+  std::vector<int8_t> old_control(size, kEmpty);
+  std::vector<Slot> old_slots(size);
+  std::string old_keys;
+  std::swap(control_, old_control);
+  std::swap(slots_, old_slots);
+  std::swap(keys_, old_keys);
+
+  count_ = 0;
+  deleted_ = 0;
+  garbage_ = 0;
+
+  for (size_t i = 0; i < old_control.size(); ++i) {
+    if (old_control[i] >= 0) {
+      const Slot &slot = old_slots[i];
+      Insert(old_keys.data() + slot.offset, slot.length, slot.hash);
+    }
+  }
 }
 
-HashTable::Probes::iterator  HashTable::Probes::end() {
-  return iterator(*this, table_.size());
+uint32_t HashTable::Match(size_t group, int8_t control) const {
+  const int8_t *group_control = control_.data() + group * kGroupSize;
+
+#ifdef __SSE2__
+  const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group_control));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(control)));
+#else
+  uint32_t match = 0;
+  for (size_t i = 0; i < kGroupSize; ++i)
+    match |= static_cast<uint32_t>(group_control[i] == control) << i;
+
+  return match;
+#endif
 }
 
-template <typename T>
-HashTable::Probes::ProbeIterator<T>::ProbeIterator(const Probes &probes, size_t probe)
-    : probes_(probes),
-      probe_(probe) {}
+namespace {
+
+const uint64_t kHashSecret[] = {
+  0xA0761D6478BD642Full, 0xE7037ED1A0B428DBull, 0x8EBC6AF09C88C6E3ull
+};
+
+// Full 128-bit product of words folded to 64 bits
+inline uint64_t Mix(uint64_t a, uint64_t b) {
+  const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
 
-template <typename T>
-T HashTable::Probes::ProbeIterator<T>::operator* () {
-  return (probes_.hash1_ + probe_ * probes_.hash2_) % probes_.table_.size();
+  return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
 }
 
-template <typename T>
-HashTable::Probes::ProbeIterator<T> & HashTable::Probes::ProbeIterator<T>::operator++() {
-  ++probe_;
-  return *this;
+// Read up to 8 bytes of key as one word
+inline uint64_t ReadWord(const char *bytes, size_t length) {
+  uint64_t word = 0;
+  std::memcpy(&word, bytes, length < 8 ? length : 8);
+
+  return word;
 }
 
-template <typename T>
-bool HashTable::Probes::ProbeIterator<T>::operator!=(ProbeIterator<T> other) {
-  return probe_ != other.probe_;
+}  // namespace
+
+// Like wyhash: every 16 bytes of key are mixed into state with one
+// 64x64->128 multiplication, so long keys cost a multiplication per
+// two words instead of a division per byte
+uint64_t HashTable::Hash(const char *key, size_t length) {
+  uint64_t state = length ^ kHashSecret[0];
+
+  size_t i = 0;
+  for (; i + 16 < length; i += 16)
+    state = Mix(ReadWord(key + i, 8) ^ kHashSecret[1], ReadWord(key + i + 8, 8) ^ state);
+
+  const size_t tail = length - i;
+  const uint64_t first = ReadWord(key + i, tail);
+  const uint64_t second = tail > 8 ? ReadWord(key + i + 8, tail - 8) : 0;
+
+  return Mix(kHashSecret[1] ^ length, Mix(first ^ kHashSecret[1], second ^ state ^ kHashSecret[2]));
 }
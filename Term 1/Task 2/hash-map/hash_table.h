@@ -1,72 +1,80 @@
 #ifndef HASH_H_
 #define HASH_H_
 
+#include <cstdint>
+
 #include <string>
 #include <vector>
-#include <iterator>
 
+// Open addressing set of strings. Slots are split into groups of 16;
+// every slot has control byte telling if it is empty, deleted, or
+// holding key with given 7 bits of hash. Whole group of control bytes
+// is compared with one SSE2 instruction, so most misses only read
+// one group. Keys are kept together in one arena
 class HashTable {
  public:
   HashTable();
 
-  ~HashTable();
-
   // Check if table contains key
   bool Has(const std::string &key) const;
 
-  // Add key to table; if count of elements exceeds size of table,
+  // Add key to table; if table becomes too full,
   // rehashes the table
   bool Add(const std::string &key);
 
   bool Remove(const std::string &key);
 
+  // Number of keys in table
   size_t Count() const;
 
+  // Number of slots in table
   size_t Size() const;
 
- private:
-  class Probes {
-   public:
-    Probes(const std::vector<std::string const *> &table, const std::string &key);
-
-    template <typename T>
-    class ProbeIterator : public std::iterator<std::input_iterator_tag, T> {
-      friend Probes;
-
-     public:
-      T operator* ();
-
-      ProbeIterator<T> & operator++();
+  // Number of groups probed when looking key up
+  size_t ProbeLength(const std::string &key) const;
 
-      bool operator!=(ProbeIterator<T> other);
-     private:
-      ProbeIterator(const Probes &probes, size_t probe);
-      const Probes &probes_;
-      size_t probe_;
-    };
+  // 64-bit hash of key; lower 7 bits go to control byte,
+  // the others choose group
+  static uint64_t Hash(const char *key, size_t length);
 
-    using iterator = ProbeIterator<size_t>;
+ private:
+  // Key is stored in arena at [offset, offset + length); its hash
+  // is kept to skip most comparisons and to rehash without reading key
+  struct Slot {
+    size_t offset;
+    size_t length;
+    uint64_t hash;
+  };
 
-    iterator begin();
+  // Returns slot holding key or Size() if there is no such slot;
+  // number of probed groups is added to probes, if given
+  size_t Find(const std::string &key, uint64_t hash, size_t *probes=nullptr) const;
 
-    iterator end();
+  // Returns first empty or deleted slot on probe path of hash
+  size_t FindFree(uint64_t hash) const;
 
-   private:
-    size_t Hash(const std::string &key) const;
+  // Put key known to be absent into table
+  void Insert(const char *key, size_t length, uint64_t hash);
 
-    const std::vector<std::string const *> &table_;
-    const size_t hash1_;
-    const size_t hash2_;
+  // Rebuild table with size slots, dropping deleted slots
+  // and removed keys from arena
+  void Rehash(size_t size);
 
-    static const int kHashParameter = 41;
-  };
-
-  void Grow();
+  // Bit mask of slots in group having given control byte
+  uint32_t Match(size_t group, int8_t control) const;
 
   size_t count_;
-  std::vector<std::string const *> table_;
+  size_t deleted_;
+  // Arena bytes of removed keys
+  size_t garbage_;
+  std::vector<int8_t> control_;
+  std::vector<Slot> slots_;
+  std::string keys_;
+
+  static const int8_t kEmpty = -128;
+  static const int8_t kDeleted = -2;
 
-  static const std::string kDeleted;
+  static const size_t kGroupSize = 16;
 
   // Initial size of hash table
   static const size_t kInitialSize = 16;
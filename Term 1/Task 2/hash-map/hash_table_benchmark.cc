@@ -0,0 +1,107 @@
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hash_table.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t kSyntheticKeys = 1000000;
+
+// Keys look like URLs of a few hosts with long common prefixes,
+// which is the hard case for weak hashes
+std::vector<std::string> GenerateUrls(size_t count) {
+  const char *hosts[] = {"https://example.com", "https://www.example.org", "http://cdn.example.net"};
+  std::mt19937_64 generator(0);
+
+  std::vector<std::string> urls;
+  for (size_t i = 0; i < count; ++i) {
+    std::string url = hosts[generator() % 3];
+    url += "/static/images/2017/05/";
+    url += std::to_string(generator() % 100000);
+    url += "/item?id=" + std::to_string(i);
+    urls.push_back(url);
+  }
+
+  return urls;
+}
+
+// Former per-character hash taken modulo table size after every symbol
+uint64_t PolynomialHash(const std::string &key, size_t size) {
+  uint64_t hash = 0;
+  for (auto symbol : key)
+    hash = (hash * 41 + symbol) % size;
+
+  return hash;
+}
+
+double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Usage: hash-table-benchmark [KEYS_FILE]; keys file has one key
+// per line, synthetic URLs are used without it
+int main(int argc, char **argv) {
+  std::vector<std::string> keys;
+  if (argc > 1) {
+    std::ifstream input(argv[1]);
+    for (std::string line; std::getline(input, line);)
+      keys.push_back(line);
+  } else {
+    keys = GenerateUrls(kSyntheticKeys);
+  }
+
+  // Every second key is inserted, so that others are misses
+  size_t bytes = 0;
+  for (auto &key : keys)
+    bytes += key.size();
+
+  uint64_t checksum = 0;
+  Clock::time_point start = Clock::now();
+  for (auto &key : keys)
+    checksum += HashTable::Hash(key.data(), key.size());
+  double hash_time = SecondsSince(start);
+
+  start = Clock::now();
+  for (auto &key : keys)
+    checksum += PolynomialHash(key, 1 << 20);
+  double polynomial_time = SecondsSince(start);
+
+  HashTable table;
+  start = Clock::now();
+  for (size_t i = 0; i < keys.size(); i += 2)
+    table.Add(keys[i]);
+  double add_time = SecondsSince(start);
+
+  size_t hits = 0;
+  start = Clock::now();
+  for (auto &key : keys)
+    hits += table.Has(key);
+  double lookup_time = SecondsSince(start);
+
+  size_t probes[2] = {0, 0};
+  size_t max_probes[2] = {0, 0};
+  for (size_t i = 0; i < keys.size(); ++i) {
+    size_t length = table.ProbeLength(keys[i]);
+    probes[i % 2] += length;
+    max_probes[i % 2] = std::max(max_probes[i % 2], length);
+  }
+
+  const double megabytes = bytes / 1e6;
+  const size_t lookups[2] = {(keys.size() + 1) / 2, keys.size() / 2};
+  std::cout << keys.size() << " keys, " << megabytes << " MB (checksum " << checksum << ")" << std::endl
+            << "hash: " << megabytes / hash_time << " MB/s, former polynomial hash: "
+            << megabytes / polynomial_time << " MB/s" << std::endl
+            << "add: " << add_time << "s, lookup: " << lookup_time << "s, "
+            << hits << " hits in table of " << table.Size() << " slots" << std::endl
+            << "groups probed on hit: " << static_cast<double>(probes[0]) / lookups[0]
+            << " average, " << max_probes[0] << " max" << std::endl
+            << "groups probed on miss: " << static_cast<double>(probes[1]) / std::max<size_t>(lookups[1], 1)
+            << " average, " << max_probes[1] << " max" << std::endl;
+
+  return 0;
+}
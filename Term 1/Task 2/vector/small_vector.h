@@ -0,0 +1,257 @@
+// Copyright Alexander Vasilyev
+
+#ifndef SMALL_VECTOR_H_
+#define SMALL_VECTOR_H_
+
+#include <cassert>
+#include <cstring>
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Vector keeping up to N elements inside the object itself;
+// heap is used only after more than N elements are pushed.
+// Elements go back inside only when heap buffer is shrunk, i.e. once
+// size drops below quarter of capacity, so vector may stay on heap
+// with N or less elements for a while
+template<typename T, size_t N, typename Allocator = std::allocator<T>>
+class SmallVector {
+ public:
+  static_assert(N > 0, "Inline capacity must be positive");
+
+  using This = SmallVector<T, N, Allocator>;
+
+  explicit SmallVector(size_t initial_size=0, const Allocator &allocator=Allocator())
+    : allocator_(allocator),
+      array_(InlineArray()),
+      size_(0),
+      capacity_(N) {
+    Reserve(initial_size);
+
+    for (; size_ < initial_size; ++size_)
+      Traits::construct(allocator_, array_ + size_);
+  }
+
+  SmallVector(const This &source)
+    : SmallVector(0, Traits::select_on_container_copy_construction(source.allocator_)) {
+    Reserve(source.size());
+
+    for (; size_ < source.size(); ++size_)
+      Traits::construct(allocator_, array_ + size_, source[size_]);
+  }
+
+  SmallVector(This &&source)
+    : allocator_(std::move(source.allocator_)),
+      array_(InlineArray()),
+      size_(0),
+      capacity_(N) {
+    Steal(source);
+  }
+
+  ~SmallVector() {
+    Clear();
+    Deallocate();
+  }
+
+  const This& operator=(const This &source) {
+    if (&source != this) {
+      This copy(source);
+      *this = std::move(copy);
+    }
+
+    return *this;
+  }
+
+  const This& operator=(This &&source) {
+    if (&source != this) {
+      Clear();
+      Deallocate();
+      allocator_ = source.allocator_;
+      Steal(source);
+    }
+
+    return *this;
+  }
+
+  void Swap(This &other) {
+    This temporary(std::move(other));
+    other = std::move(*this);
+    *this = std::move(temporary);
+  }
+
+  T & operator[](size_t index) {
+    assert(index < size_);
+
+    return array_[index];
+  }
+
+  const T& operator[](size_t index) const {
+    assert(index < size_);
+
+    return array_[index];
+  }
+
+  // Number of elements in vector
+  size_t size() const {
+    return size_;
+  }
+
+  // Number of elements vector is capable of storing without reallocation
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  // Returns true if elements are stored inside the object
+  bool IsInline() const {
+    return array_ == InlineArray();
+  }
+
+  T *data() {
+    return array_;
+  }
+
+  const T *data() const {
+    return array_;
+  }
+
+  // Allocate place for at least capacity elements
+  void Reserve(size_t capacity) {
+    if (capacity > capacity_)
+      Realloc(GetMinimalCapacity(capacity));
+  }
+
+  // Append element at the end
+  void PushBack(const T &element) {
+    EmplaceBack(element);
+  }
+
+  void PushBack(T &&element) {
+    EmplaceBack(std::move(element));
+  }
+
+  // Construct element at the end from arguments
+  template<typename... Args>
+  T & EmplaceBack(Args &&... args) {
+    if (size() == capacity())
+      Realloc(capacity_ * 2);
+
+    Traits::construct(allocator_, array_ + size_, std::forward<Args>(args)...);
+    ++size_;
+
+    return array_[size_ - 1];
+  }
+
+  // Remove element from the end; heap buffer is shrunk like in Vector,
+  // when size drops below quarter of capacity, and elements return
+  // inside if shrunk capacity is not greater than N
+  T PopBack() {
+    assert(size() > 0);
+
+    T element(std::move(array_[size_ - 1]));
+
+    --size_;
+    Traits::destroy(allocator_, array_ + size_);
+
+    if (!IsInline() && size() * 4 < capacity())
+      Realloc(capacity_ / 4);
+
+    return element;
+  }
+
+  // Destroy all elements keeping allocated place
+  void Clear() {
+    while (size_)
+      Traits::destroy(allocator_, array_ + --size_);
+  }
+
+ private:
+  using Traits = std::allocator_traits<Allocator>;
+  using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+  T *InlineArray() {
+    return reinterpret_cast<T *>(inline_);
+  }
+
+  const T *InlineArray() const {
+    return reinterpret_cast<const T *>(inline_);
+  }
+
+  // Minimal power of 2 times N not less than desired capacity
+  static size_t GetMinimalCapacity(size_t desired) {
+    size_t capacity = N;
+    while (capacity < desired)
+      capacity <<= 1;
+
+    return capacity;
+  }
+
+  // Move elements to buffer of new capacity, which is the inline one
+  // if capacity is not greater than N
+  void Realloc(size_t capacity) {
+    assert(capacity >= size_);
+
+    const bool to_inline = capacity <= N;
+    if (to_inline) {
+      if (IsInline())
+        return;
+      capacity = N;
+    }
+
+    T *new_array = to_inline ? InlineArray() : Traits::allocate(allocator_, capacity);
+    size_t moved = 0;
+    try {
+      for (; moved < size_; ++moved)
+        Traits::construct(allocator_, new_array + moved, std::move_if_noexcept(array_[moved]));
+    } catch (...) {
+      while (moved)
+        Traits::destroy(allocator_, new_array + --moved);
+      if (!to_inline)
+        Traits::deallocate(allocator_, new_array, capacity);
+      throw;
+    }
+
+    for (size_t i = 0; i < size_; ++i)
+      Traits::destroy(allocator_, array_ + i);
+
+    Deallocate();
+    array_ = new_array;
+    capacity_ = capacity;
+  }
+
+  // Free heap buffer, if any; elements must be destroyed already
+  void Deallocate() {
+    if (!IsInline())
+      Traits::deallocate(allocator_, array_, capacity_);
+
+    array_ = InlineArray();
+    capacity_ = N;
+  }
+
+  // Take elements of source into this empty inline vector: heap buffer
+  // is taken as is, inline elements are moved one by one
+  void Steal(This &source) {
+    if (source.IsInline()) {
+      for (; size_ < source.size_; ++size_)
+        Traits::construct(allocator_, array_ + size_, std::move(source.array_[size_]));
+      source.Clear();
+      return;
+    }
+
+    array_ = source.array_;
+    size_ = source.size_;
+    capacity_ = source.capacity_;
+
+    source.array_ = source.InlineArray();
+    source.size_ = 0;
+    source.capacity_ = N;
+  }
+
+  Allocator allocator_;
+  T *array_;
+  size_t size_;
+  size_t capacity_;
+  Storage inline_[N];
+};
+
+#endif // SMALL_VECTOR_H_
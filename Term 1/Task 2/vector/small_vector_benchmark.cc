@@ -0,0 +1,68 @@
+// Copyright Alexander Vasilyev
+
+#include <cstdlib>
+#include <ctime>
+
+#include <iostream>
+#include <new>
+#include <string>
+
+#include "small_vector.h"
+#include "vector.h"
+
+static const size_t kInlineSize = 16;
+
+static size_t allocation_count = 0;
+
+void *operator new(size_t size) {
+  ++allocation_count;
+
+  void *address = std::malloc(size ? size : 1);
+  if (!address)
+    throw std::bad_alloc();
+
+  return address;
+}
+
+void operator delete(void *address) noexcept {
+  std::free(address);
+}
+
+void operator delete(void *address, size_t) noexcept {
+  std::free(address);
+}
+
+// Fills count temporary vectors with up to max_size elements each
+// and prints time and number of allocations spent
+template<typename VectorT>
+void Measure(const std::string &name, size_t count, size_t max_size) {
+  srand(0);
+  size_t checksum = 0;
+  size_t allocations = allocation_count;
+  clock_t start = clock();
+
+  for (size_t i = 0; i < count; ++i) {
+    VectorT vector;
+    size_t size = rand() % (max_size + 1);
+    for (size_t j = 0; j < size; ++j)
+      vector.PushBack(static_cast<int>(i + j));
+    for (size_t j = 0; j < vector.size(); ++j)
+      checksum += vector[j];
+  }
+
+  double seconds = static_cast<double>(clock() - start) / CLOCKS_PER_SEC;
+  std::cout << name << " up to " << max_size << " elements: " << seconds << "s, "
+            << allocation_count - allocations << " allocations"
+            << " (checksum " << checksum << ")" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  size_t count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+  for (size_t max_size : {kInlineSize - 1, 4 * kInlineSize}) {
+    Measure<Vector<int>>("Vector", count, max_size);
+    Measure<SmallVector<int, kInlineSize>>("SmallVector", count, max_size);
+  }
+
+  return 0;
+}
@@ -0,0 +1,34 @@
+#include <cassert>
+#include <iostream>
+#include <string>
+
+#include "small_vector.h"
+#include "vector.h"
+
+// Reserved capacity is rounded up to power of 2 only if needed,
+// and pushing up to it does not reallocate
+template<typename T, typename V>
+void TestReserve(size_t capacity, size_t expected) {
+  V vector;
+  vector.Reserve(capacity);
+  assert(vector.capacity() == expected);
+
+  const auto data = vector.data();
+  for (size_t i = 0; i < capacity; ++i)
+    vector.PushBack(T());
+  assert(vector.data() == data && vector.capacity() == expected);
+}
+
+int main() {
+  TestReserve<int, Vector<int>>(1000, 1024);
+  TestReserve<int, Vector<int>>(1024, 1024);
+  // Buffer of 4 MB is mapped
+  TestReserve<int, Vector<int>>(1 << 20, 1 << 20);
+  TestReserve<std::string, Vector<std::string>>(64, 64);
+  TestReserve<int, SmallVector<int, 8>>(8, 8);
+  TestReserve<int, SmallVector<int, 8>>(64, 64);
+  TestReserve<int, SmallVector<int, 8>>(65, 128);
+
+  std::cout << "OK" << std::endl;
+  return 0;
+}
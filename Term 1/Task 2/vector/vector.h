@@ -1,68 +1,97 @@
 // Copyright Alexander Vasilyev
 
-#ifndef SEGMENTS_ARRAY_H_
-#define SEGMENTS_ARRAY_H_
+#ifndef VECTOR_H_
+#define VECTOR_H_
 
 #include <cassert>
 #include <cstring>
 
+#include <memory>
+#include <new>
 #include <type_traits>
+#include <utility>
 
-// Automatically reallocated array with constant (
-// // Remove element from the endh
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Buffers of trivially copyable elements from this size on are mapped
+// directly, so that mremap can grow them without copying
+const size_t kVectorMappingThreshold = 1 << 20;
+
+// Automatically reallocated array with amortized constant
 // push and pop
-template<typename T>
+template<typename T, typename Allocator = std::allocator<T>>
 class Vector {
  public:
-  static_assert(std::is_pod<T>::value, "Only PODs are supported");
-
-  explicit Vector(size_t initial_size=0)
-    : size_(initial_size),
-      capacity_(GetMinimalCapacity(initial_size)) {
-    array_ = new T[capacity_];
-    std::memset(array_, 0, sizeof(T) * capacity_);
+  explicit Vector(size_t initial_size=0, const Allocator &allocator=Allocator())
+    : allocator_(allocator),
+      array_(nullptr),
+      size_(0),
+      capacity_(0) {
+    Realloc(GetMinimalCapacity(initial_size));
+
+    for (; size_ < initial_size; ++size_)
+      Traits::construct(allocator_, array_ + size_);
   }
 
-  Vector(const Vector<T> &source) {
-    capacity_ = source.capacity_;
-    size_ = source.size_;
+  Vector(const Vector<T, Allocator> &source)
+    : Vector(0, Traits::select_on_container_copy_construction(source.allocator_)) {
+    Reserve(source.size());
 
-    array_ = new T[capacity_];
-    std::memcpy(array_, source.array_, sizeof(T) * capacity_);
+    for (; size_ < source.size(); ++size_)
+      Traits::construct(allocator_, array_ + size_, source[size_]);
   }
 
-  ~Vector() {
-    delete[] array_;
+  Vector(Vector<T, Allocator> &&source)
+    : allocator_(std::move(source.allocator_)),
+      array_(source.array_),
+      size_(source.size_),
+      capacity_(source.capacity_) {
+    source.array_ = nullptr;
+    source.size_ = 0;
+    source.capacity_ = 0;
   }
 
-  const Vector<T>& operator=(const Vector<T> &source) {
-    if (source == *this)
-      return *this;
+  ~Vector() {
+    Clear();
+    Deallocate(array_, capacity_);
+  }
 
-    capacity_ = source.capacity_;
-    size_ = source.size_;
+  const Vector<T, Allocator>& operator=(const Vector<T, Allocator> &source) {
+    if (&source != this) {
+      Vector<T, Allocator> copy(source);
+      Swap(copy);
+    }
 
-    delete[] array_;
+    return *this;
+  }
 
-    array_ = new T[capacity_];
-    std::memcpy(array_, source.array_, sizeof(T) * capacity_);
+  const Vector<T, Allocator>& operator=(Vector<T, Allocator> &&source) {
+    Swap(source);
 
     return *this;
   }
 
+  void Swap(Vector<T, Allocator> &other) {
+    std::swap(allocator_, other.allocator_);
+    std::swap(array_, other.array_);
+    std::swap(size_, other.size_);
+    std::swap(capacity_, other.capacity_);
+  }
+
   T & operator[](size_t index) {
-    assert(index >= 0 && index < size_);
+    assert(index < size_);
 
     return array_[index];
   }
 
-  const T& operator[](int index) const {
-    assert(index >= 0 && index < size_);
+  const T& operator[](size_t index) const {
+    assert(index < size_);
 
     return array_[index];
   }
 
-
   // Number of elements in vector
   size_t size() const {
     return size_;
@@ -73,62 +102,177 @@ class Vector {
     return capacity_;
   }
 
+  T *data() {
+    return array_;
+  }
+
+  const T *data() const {
+    return array_;
+  }
+
+  // Allocate place for at least capacity elements
+  void Reserve(size_t capacity) {
+    if (capacity > capacity_)
+      Realloc(GetMinimalCapacity(capacity));
+  }
+
   // Append element at the end
-  void PushBack(T element) {
+  void PushBack(const T &element) {
+    EmplaceBack(element);
+  }
+
+  void PushBack(T &&element) {
+    EmplaceBack(std::move(element));
+  }
+
+  // Construct element at the end from arguments
+  template<typename... Args>
+  T & EmplaceBack(Args &&... args) {
     if (size() == capacity())
       Grow();
 
+    Traits::construct(allocator_, array_ + size_, std::forward<Args>(args)...);
     ++size_;
-    (*this)[size() - 1] = element;
+
+    return array_[size_ - 1];
   }
 
   // Remove element from the end
   T PopBack() {
     assert(size() > 0);
 
-    T element = (*this)[size() - 1];
+    T element(std::move(array_[size_ - 1]));
 
     --size_;
+    Traits::destroy(allocator_, array_ + size_);
+
     if (size() && size() * 4 < capacity())
       Shrink();
 
     return element;
   }
 
+  // Destroy all elements keeping allocated place
+  void Clear() {
+    while (size_)
+      Traits::destroy(allocator_, array_ + --size_);
+  }
+
  private:
-  // Uses bit-wise magic to get minimal power of 2 greater than desired capacity
+  using Traits = std::allocator_traits<Allocator>;
+
+  // Elements of such type are moved by memcpy; mremap is used
+  // only with the default allocator, as custom ones own their memory
+  static const bool kTrivial = std::is_trivially_copyable<T>::value;
+  static const bool kMappable = kTrivial && std::is_same<Allocator, std::allocator<T>>::value;
+
+  // Minimal power of 2 not less than desired capacity, so that
+  // reserving power of 2 allocates exactly that much
   size_t GetMinimalCapacity(size_t desired) {
     size_t capacity = 2;
-    while (desired & ~(capacity - 1))
+    while (capacity < desired)
       capacity <<= 1;
 
     return capacity;
   }
 
+  // Moved-from vector has no buffer at all
   void Grow() {
-    Realloc(capacity_ * 2);
+    Realloc(capacity_ ? capacity_ * 2 : GetMinimalCapacity(0));
   }
 
   void Shrink() {
     Realloc(capacity_ / 4);
   }
 
+  // Move elements to buffer of new capacity; new slots are left
+  // uninitialized, they are constructed on push
   void Realloc(size_t capacity) {
     assert(capacity >= size_);
 
-    T *new_array = new T[capacity];
-    std::memcpy(new_array, array_, sizeof(T) * size_);
-    std::memset(new_array + size_, 0, sizeof(T) * (capacity - size_));
-
-    delete[] array_;
+    if (Remap(capacity))
+      return;
+
+    T *new_array = Allocate(capacity);
+    if (kTrivial) {
+      if (size_)
+        std::memcpy(static_cast<void *>(new_array), array_, sizeof(T) * size_);
+    } else {
+      size_t moved = 0;
+      try {
+        for (; moved < size_; ++moved)
+          Traits::construct(allocator_, new_array + moved, std::move_if_noexcept(array_[moved]));
+      } catch (...) {
+        while (moved)
+          Traits::destroy(allocator_, new_array + --moved);
+        Deallocate(new_array, capacity);
+        throw;
+      }
+
+      for (size_t i = 0; i < size_; ++i)
+        Traits::destroy(allocator_, array_ + i);
+    }
+
+    Deallocate(array_, capacity_);
     array_ = new_array;
+    capacity_ = capacity;
+  }
 
+  static bool IsMappedSize(size_t capacity) {
+    return capacity * sizeof(T) >= kVectorMappingThreshold;
+  }
+
+  T *Allocate(size_t capacity) {
+#ifdef __linux__
+    if (kMappable && IsMappedSize(capacity)) {
+      void *address = mmap(nullptr, capacity * sizeof(T), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (address == MAP_FAILED)
+        throw std::bad_alloc();
+
+      return static_cast<T *>(address);
+    }
+#endif
+    return Traits::allocate(allocator_, capacity);
+  }
+
+  void Deallocate(T *array, size_t capacity) {
+    if (!array)
+      return;
+
+#ifdef __linux__
+    if (kMappable && IsMappedSize(capacity)) {
+      munmap(array, capacity * sizeof(T));
+      return;
+    }
+#endif
+    Traits::deallocate(allocator_, array, capacity);
+  }
+
+  // Resize mapped buffer in place or by moving its pages;
+  // returns false if buffer is not mapped before or after
+  bool Remap(size_t capacity) {
+#ifdef __linux__
+    if (!kMappable || !array_ || !IsMappedSize(capacity_) || !IsMappedSize(capacity))
+      return false;
+
+    void *address = mremap(array_, capacity_ * sizeof(T), capacity * sizeof(T), MREMAP_MAYMOVE);
+    if (address == MAP_FAILED)
+      throw std::bad_alloc();
+
+    array_ = static_cast<T *>(address);
     capacity_ = capacity;
+
+    return true;
+#else
+    return false;
+#endif
   }
 
+  Allocator allocator_;
   T *array_;
   size_t size_;
   size_t capacity_;
 };
 
-#endif // SEGMENTS_ARRAY_H_
+#endif // VECTOR_H_